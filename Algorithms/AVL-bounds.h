@@ -0,0 +1,392 @@
+#ifndef AVL_BOUNDS_H
+#define AVL_BOUNDS_H
+
+/*
+	Bounds on the size of an AVL tree of a given height, used to size node pools.
+	The height of a single node is 0, and of an empty tree -1.
+
+	- minVerts(h): fewest vertices an AVL tree of height h can have,
+	  N(h) = N(h-1) + N(h-2) + 1 with N(0) = 1 and N(1) = 2, which is F(h+3) - 1
+	- maxVerts(h): most vertices, the perfect tree, 2^(h+1) - 1
+	- minHeight(n) and maxHeight(n): the other way around, the range of heights
+	  an AVL tree of n vertices can have; both constexpr, for sizing stacks at compile time
+
+	minVerts and maxVerts are exact as long as the answer fits in 64 bits, minVerts up to height kMaxMinVertsHeight
+	out of a table built at compile time, maxVerts up to height kMaxMaxVertsHeight with a shift.
+	Past that they saturate at UINT64_MAX, and minVertsBig / maxVertsBig give the exact answer
+	as a BigUint: Fibonacci numbers by fast doubling, which is the 2x2 matrix power
+	[[1,1],[1,0]]^k with the redundant entries dropped, so 0(log h) big multiplications.
+	The answers grow by a bit or so per level, so the big versions only take heights up to
+	kMaxBigHeight and throw std::out_of_range above it; callers reading heights from users
+	check against kMaxBigHeight first.
+
+	BatchInput and BatchOutput read and write whitespace separated numbers through
+	large buffers, for the batch modes of the AVL-*.cpp programs. The batch modes answer
+	heights that fit the 64 bit tables from the tables, and only build a BigUint past them.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+//largest heights whose bounds fit in 64 bits, N(90) = F(93) - 1 and 2^64 - 1
+const int kMaxMinVertsHeight = 90;
+const int kMaxMaxVertsHeight = 63;
+
+//largest height minVertsBig and maxVertsBig take, where 2^(h+1) - 1 has about 30,000 digits
+//and takes milliseconds; the cost of printing grows with the square of h
+const int64_t kMaxBigHeight = 100000;
+
+struct MinVertsTable {
+	uint64_t verts[kMaxMinVertsHeight + 1];
+};
+
+constexpr MinVertsTable makeMinVertsTable(){
+	MinVertsTable table = {};
+	table.verts[0] = 1;
+	table.verts[1] = 2;
+	for(int h = 2; h <= kMaxMinVertsHeight; h++){
+		table.verts[h] = table.verts[h - 1] + table.verts[h - 2] + 1;
+	}
+	return table;
+}
+
+constexpr MinVertsTable kMinVertsTable = makeMinVertsTable();
+
+static_assert(kMinVertsTable.verts[kMaxMinVertsHeight] == 12200160415121876737ull, "N(90) is F(93) - 1");
+
+constexpr uint64_t minVerts(int h){
+	return h < 0 ? 0 : (h <= kMaxMinVertsHeight ? kMinVertsTable.verts[h] : UINT64_MAX);
+}
+
+constexpr uint64_t maxVerts(int h){
+	return h < 0 ? 0 : (h < kMaxMaxVertsHeight ? (uint64_t(1) << (h + 1)) - 1 : UINT64_MAX);
+}
+
+//least height of an AVL tree with n vertices, floor(log2 n), -1 for the empty tree
+constexpr int minHeight(uint64_t n){
+	int h = -1;
+	while(n != 0){
+		n >>= 1;
+		h++;
+	}
+	return h;
+}
+
+//greatest height of an AVL tree with n vertices, the last h with N(h) <= n,
+//by binary search over the ~1.44 log2 n entries of the table, so 0(log log n)
+constexpr int maxHeight(uint64_t n){
+	int lo = -1, hi = kMaxMinVertsHeight; //N(lo) <= n always holds, taking N(-1) = 0
+	while(lo < hi){
+		const int mid = lo + (hi - lo + 1) / 2;
+		if(kMinVertsTable.verts[mid] <= n)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+static_assert(maxHeight(0) == -1 && maxHeight(1) == 0 && maxHeight(3) == 1 && maxHeight(4) == 2, "small trees");
+static_assert(maxHeight(UINT64_MAX) == kMaxMinVertsHeight, "no 64 bit tree is taller than 90");
+
+//unsigned integer of any size, little endian 32 bit limbs with no leading zero limbs
+class BigUint {
+public:
+	BigUint(uint64_t x = 0){
+		while(x != 0){
+			limbs.push_back((uint32_t)x);
+			x >>= 32;
+		}
+	}
+
+	//2^bits - 1
+	static BigUint allOnes(size_t bits){
+		BigUint r;
+		r.limbs.assign(bits / 32, 0xFFFFFFFFu);
+		if(bits % 32 != 0)
+			r.limbs.push_back((uint32_t)((uint64_t(1) << (bits % 32)) - 1));
+		return r;
+	}
+
+	friend BigUint operator+(const BigUint& a, const BigUint& b){
+		const BigUint& big = a.limbs.size() >= b.limbs.size() ? a : b;
+		const BigUint& small = a.limbs.size() >= b.limbs.size() ? b : a;
+		BigUint r;
+		r.limbs.resize(big.limbs.size());
+		uint64_t carry = 0;
+		for(size_t i = 0; i < big.limbs.size(); i++){
+			carry += (uint64_t)big.limbs[i] + (i < small.limbs.size() ? small.limbs[i] : 0);
+			r.limbs[i] = (uint32_t)carry;
+			carry >>= 32;
+		}
+		if(carry != 0)
+			r.limbs.push_back((uint32_t)carry);
+		return r;
+	}
+
+	//a - b, for a >= b
+	friend BigUint operator-(const BigUint& a, const BigUint& b){
+		BigUint r;
+		r.limbs.resize(a.limbs.size());
+		int64_t borrow = 0;
+		for(size_t i = 0; i < a.limbs.size(); i++){
+			int64_t d = (int64_t)a.limbs[i] - (i < b.limbs.size() ? b.limbs[i] : 0) - borrow;
+			borrow = d < 0;
+			r.limbs[i] = (uint32_t)(d + (borrow << 32));
+		}
+		r.trim();
+		return r;
+	}
+
+	//schoolbook product
+	friend BigUint operator*(const BigUint& a, const BigUint& b){
+		BigUint r;
+		if(a.limbs.empty() || b.limbs.empty())
+			return r;
+		r.limbs.assign(a.limbs.size() + b.limbs.size(), 0);
+		for(size_t i = 0; i < a.limbs.size(); i++){
+			uint64_t carry = 0;
+			for(size_t j = 0; j < b.limbs.size(); j++){
+				carry += (uint64_t)a.limbs[i] * b.limbs[j] + r.limbs[i + j];
+				r.limbs[i + j] = (uint32_t)carry;
+				carry >>= 32;
+			}
+			r.limbs[i + b.limbs.size()] = (uint32_t)carry;
+		}
+		r.trim();
+		return r;
+	}
+
+	bool fits64() const { return limbs.size() <= 2; }
+
+	uint64_t low64() const {
+		uint64_t x = 0;
+		for(size_t i = std::min<size_t>(limbs.size(), 2); i-- > 0; ){
+			x = (x << 32) | limbs[i];
+		}
+		return x;
+	}
+
+	//decimal digits, by peeling off 9 digits at a time
+	std::string toString() const {
+		if(limbs.empty())
+			return "0";
+		std::vector<uint32_t> rest = limbs;
+		std::vector<uint32_t> chunks;
+		while(!rest.empty()){
+			uint64_t rem = 0;
+			for(size_t i = rest.size(); i-- > 0; ){
+				uint64_t cur = (rem << 32) | rest[i];
+				rest[i] = (uint32_t)(cur / 1000000000);
+				rem = cur % 1000000000;
+			}
+			while(!rest.empty() && rest.back() == 0){
+				rest.pop_back();
+			}
+			chunks.push_back((uint32_t)rem);
+		}
+		std::string s = std::to_string(chunks.back());
+		char digits[16];
+		for(size_t i = chunks.size() - 1; i-- > 0; ){
+			snprintf(digits, sizeof(digits), "%09u", chunks[i]);
+			s += digits;
+		}
+		return s;
+	}
+
+private:
+	void trim(){
+		while(!limbs.empty() && limbs.back() == 0){
+			limbs.pop_back();
+		}
+	}
+
+	std::vector<uint32_t> limbs;
+};
+
+//F(k) with F(0) = 0 and F(1) = 1, by fast doubling:
+//F(2k) = F(k) * (2F(k+1) - F(k)) and F(2k+1) = F(k)^2 + F(k+1)^2
+inline BigUint fibonacciBig(uint64_t k){
+	BigUint a = 0, b = 1; //F(i) and F(i+1) for i = the bits of k read so far
+	for(int bit = 63; bit >= 0; bit--){
+		BigUint even = a * (b + b - a);
+		BigUint odd = a * a + b * b;
+		if((k >> bit) & 1){
+			a = odd;
+			b = even + odd;
+		} else {
+			a = even;
+			b = odd;
+		}
+	}
+	return a;
+}
+
+//h at most kMaxBigHeight
+inline BigUint minVertsBig(int64_t h){
+	if(h > kMaxBigHeight)
+		throw std::out_of_range("height above kMaxBigHeight");
+	if(h < 0)
+		return 0;
+	if(h <= kMaxMinVertsHeight)
+		return minVerts((int)h);
+	return fibonacciBig(h + 3) - 1;
+}
+
+//h at most kMaxBigHeight
+inline BigUint maxVertsBig(int64_t h){
+	if(h > kMaxBigHeight)
+		throw std::out_of_range("height above kMaxBigHeight");
+	return h < 0 ? BigUint(0) : BigUint::allOnes(h + 1);
+}
+
+//what BatchInput::next found
+enum BatchToken { kBatchEnd, kBatchNumber, kBatchInvalid };
+
+//whitespace separated integers from a file, read in large blocks
+class BatchInput {
+public:
+	explicit BatchInput(FILE* in = stdin) : in(in), pos(0), len(0) {}
+
+	//the next whitespace separated word, kBatchInvalid when it is not an optional minus
+	//followed by digits that fit in an int64_t, in which case the whole word is skipped
+	BatchToken next(int64_t& x){
+		bool negative;
+		uint64_t value;
+		const BatchToken t = word(negative, value, uint64_t(INT64_MAX) + 1, uint64_t(INT64_MAX));
+		if(t == kBatchNumber)
+			x = negative ? (int64_t)(uint64_t(0) - value) : (int64_t)value;
+		return t;
+	}
+
+	//the same for counts, digits that fit in a uint64_t: kBatchInvalid for any leading minus
+	BatchToken next(uint64_t& x){
+		bool negative;
+		uint64_t value;
+		const BatchToken t = word(negative, value, 0, UINT64_MAX);
+		if(t != kBatchNumber)
+			return t;
+		if(negative)
+			return kBatchInvalid;
+		x = value;
+		return t;
+	}
+
+private:
+	//an optional minus and digits up to negativeLimit or positiveLimit, the whole word skipped
+	BatchToken word(bool& negative, uint64_t& value, uint64_t negativeLimit, uint64_t positiveLimit){
+		int c = skipSpace();
+		if(c < 0)
+			return kBatchEnd;
+		negative = false;
+		if(c == '-'){
+			negative = true;
+			c = get();
+		}
+		bool valid = c >= '0' && c <= '9';
+		value = 0;
+		const uint64_t limit = negative ? negativeLimit : positiveLimit;
+		while(c >= '0' && c <= '9'){
+			const unsigned digit = c - '0';
+			if(limit < digit || value > (limit - digit) / 10)
+				valid = false;
+			else
+				value = value * 10 + digit;
+			c = get();
+		}
+		while(c >= 0 && !isSpace(c)){
+			valid = false;
+			c = get();
+		}
+		return valid ? kBatchNumber : kBatchInvalid;
+	}
+
+	int get(){
+		if(pos == len){
+			len = fread(buffer, 1, sizeof(buffer), in);
+			pos = 0;
+			if(len == 0)
+				return -1;
+		}
+		return (unsigned char)buffer[pos++];
+	}
+
+	static bool isSpace(int c){
+		return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+	}
+
+	int skipSpace(){
+		int c = get();
+		while(isSpace(c)){
+			c = get();
+		}
+		return c;
+	}
+
+	FILE* in;
+	size_t pos, len;
+	char buffer[1 << 16];
+};
+
+//text collected in a large buffer and written with fwrite when it fills up
+class BatchOutput {
+public:
+	explicit BatchOutput(FILE* out = stdout) : out(out), used(0) {}
+	~BatchOutput() { flush(); }
+
+	void put(char c){
+		if(used == sizeof(buffer))
+			flush();
+		buffer[used++] = c;
+	}
+
+	void put(const std::string& s){
+		for(size_t i = 0; i < s.size(); i++){
+			put(s[i]);
+		}
+	}
+
+	void put(uint64_t x){
+		char digits[20];
+		int n = 0;
+		do {
+			digits[n++] = (char)('0' + x % 10);
+			x /= 10;
+		} while(x != 0);
+		while(n > 0){
+			put(digits[--n]);
+		}
+	}
+
+	void put(int x){
+		if(x < 0)
+			put('-');
+		put(x < 0 ? uint64_t(0) - (uint64_t)x : (uint64_t)x);
+	}
+
+	void put(const BigUint& x){
+		if(x.fits64())
+			put(x.low64());
+		else
+			put(x.toString());
+	}
+
+	void flush(){
+		if(used > 0)
+			fwrite(buffer, 1, used, out);
+		used = 0;
+		fflush(out);
+	}
+
+private:
+	FILE* out;
+	size_t used;
+	char buffer[1 << 16];
+};
+
+#endif
@@ -1,18 +1,42 @@
 #include <iostream>
-#include <math.h>
+#include <string.h>
 #include <stdio.h>
 
+#include "AVL-bounds.h"
+
 using namespace std;
 
-int main(){
-	int input;
+//run with "batch" to read heights from stdin and write one answer per line,
+//or an error on the line of a height that is not a number or is above kMaxBigHeight
+int main(int argc, char* argv[]){
+	if(argc > 1 && strcmp(argv[1], "batch") == 0){
+		BatchInput in;
+		BatchOutput out;
+		int64_t h;
+		for(BatchToken t = in.next(h); t != kBatchEnd; t = in.next(h)){
+			if(t == kBatchInvalid)
+				out.put("error: not a height");
+			else if(h > kMaxBigHeight)
+				out.put("error: height above " + to_string(kMaxBigHeight));
+			else if(h <= kMaxMaxVertsHeight)
+				out.put(maxVerts((int)max<int64_t>(h, -1)));
+			else
+				out.put(maxVertsBig(h));
+			out.put('\n');
+		}
+		return 0;
+	}
 
-	cout << "Enter height of AVL tree: ";
-	cin >> input;
+	int64_t input;
 
-	int maxVert = pow(2, (input+1)) - 1;
+	cout << "Enter height of AVL tree: ";
+	if(!(cin >> input) || input > kMaxBigHeight){
+		cout << "The height must be a number of at most " << kMaxBigHeight << endl;
+		return 1;
+	}
 
-	cout << "Maximum number of vertices: " << maxVert << endl;
+	//2^(h+1) - 1, exact, where pow went through a double and an int
+	cout << "Maximum number of vertices: " << maxVertsBig(input).toString() << endl;
 
 	return 0;
 }
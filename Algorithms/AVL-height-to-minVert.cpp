@@ -1,29 +1,46 @@
 #include <iostream>
-#include <math.h>
+#include <string.h>
 #include <stdio.h>
 
+#include "AVL-bounds.h"
+
 using namespace std;
 
-int findMinVerts(int h){
-	int a = 1;
-	int b = 2;
-	int c;
+//fewest vertices in an AVL tree of height h, exact at any height, see AVL-bounds.h
+BigUint findMinVerts(int64_t h){
+	return minVertsBig(h);
+}
 
-	for(int i = 1; i < h; i++){
-		c = a + b + 1;
-		a = b;
-		b = c;
+//run with "batch" to read heights from stdin and write one answer per line,
+//or an error on the line of a height that is not a number or is above kMaxBigHeight
+int main(int argc, char* argv[]){
+	if(argc > 1 && strcmp(argv[1], "batch") == 0){
+		BatchInput in;
+		BatchOutput out;
+		int64_t h;
+		for(BatchToken t = in.next(h); t != kBatchEnd; t = in.next(h)){
+			if(t == kBatchInvalid)
+				out.put("error: not a height");
+			else if(h > kMaxBigHeight)
+				out.put("error: height above " + to_string(kMaxBigHeight));
+			else if(h <= kMaxMinVertsHeight)
+				out.put(minVerts((int)max<int64_t>(h, -1)));
+			else
+				out.put(findMinVerts(h));
+			out.put('\n');
+		}
+		return 0;
 	}
-	return b;
-}
 
-int main(){
-	int input;
+	int64_t input;
 
 	cout << "Enter the height of the AVL tree: ";
-	cin >> input;
+	if(!(cin >> input) || input > kMaxBigHeight){
+		cout << "The height must be a number of at most " << kMaxBigHeight << endl;
+		return 1;
+	}
 
-	cout << "The minimum number of vertices is: " << findMinVerts(input) << endl;
+	cout << "The minimum number of vertices is: " << findMinVerts(input).toString() << endl;
 
 	return 0;
 }
@@ -1,18 +1,111 @@
 #include <iostream>
-#include <math.h>
+#include <vector>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+
+#include "AVL-bounds.h"
 
 using namespace std;
 
-int main(){
-	int input;
+/*
+	check every n up to limit against brute force: build the set of sizes an AVL tree of
+	each height can have, straight from the definition (the subtrees of a node differ in height
+	by at most one), and compare the least and greatest height of each size with minHeight and maxHeight
+*/
+int check(int limit){
+	//sizes[h][n] is true when some AVL tree of height h has n vertices, sizes[0] is height -1
+	vector<vector<bool>> sizes;
+	sizes.push_back(vector<bool>(limit + 1, false));
+	sizes[0][0] = true;
+	sizes.push_back(vector<bool>(limit + 1, false));
+	sizes[1][1] = true;
+	while(true){
+		const size_t h = sizes.size();
+		vector<bool> next(limit + 1, false);
+		bool any = false;
+		for(int a = 0; a <= limit; a++){
+			for(int b = 0; a + b + 1 <= limit; b++){
+				bool tall = sizes[h - 1][a] && sizes[h - 1][b];
+				bool leftTall = sizes[h - 1][a] && sizes[h - 2][b];
+				bool rightTall = sizes[h - 2][a] && sizes[h - 1][b];
+				if(tall || leftTall || rightTall){
+					next[a + b + 1] = true;
+					any = true;
+				}
+			}
+		}
+		if(!any)
+			break;
+		sizes.push_back(next);
+	}
+
+	int failures = 0;
+	for(int n = 0; n <= limit; n++){
+		int lo = -2, hi = -2;
+		for(size_t h = 0; h < sizes.size(); h++){
+			if(sizes[h][n]){
+				if(lo == -2)
+					lo = (int)h - 1;
+				hi = (int)h - 1;
+			}
+		}
+		if(lo != minHeight(n) || hi != maxHeight(n)){
+			cout << "n = " << n << ": expected " << lo << " " << hi
+				<< ", got " << minHeight(n) << " " << maxHeight(n) << endl;
+			failures++;
+		}
+	}
+	cout << (failures == 0 ? "all " : "failures in ") << limit + 1 << " sizes checked" << endl;
+	return failures == 0 ? 0 : 1;
+}
+
+//the height of a single vertex is 0, the same as in the other AVL-*.cpp programs
+//run with "batch" to read vertex counts from stdin and write both heights on one line per count,
+//or an error on the line of a count that is not a number, is negative or is past UINT64_MAX,
+//or with "check [limit]" to compare against brute force
+int main(int argc, char* argv[]){
+	if(argc > 1 && strcmp(argv[1], "batch") == 0){
+		BatchInput in;
+		BatchOutput out;
+		uint64_t n;
+		for(BatchToken t = in.next(n); t != kBatchEnd; t = in.next(n)){
+			if(t == kBatchInvalid){
+				out.put("error: not a vertex count");
+			} else {
+				out.put(minHeight(n));
+				out.put(' ');
+				out.put(maxHeight(n));
+			}
+			out.put('\n');
+		}
+		return 0;
+	}
+	if(argc > 1 && strcmp(argv[1], "check") == 0){
+		return check(argc > 2 ? atoi(argv[2]) : 2000);
+	}
+
+	string word;
+	uint64_t input = 0;
+	bool valid = false;
 
 	cout << "Enter the number of vertices: ";
-	cin >> input;
+	if(cin >> word && word[0] != '-'){
+		char* end;
+		errno = 0;
+		input = strtoull(word.c_str(), &end, 10);
+		valid = end != word.c_str() && *end == '\0' && errno == 0;
+	}
+	if(!valid){
+		cout << "The number of vertices must be a number from 0 to " << UINT64_MAX << endl;
+		return 1;
+	}
 
-	cout << "The minimum height of the tree is: " << (int)ceil(log2(input+1)) << endl;
+	cout << "The minimum height of the tree is: " << minHeight(input) << endl;
 
-	cout << "The maximum height of the tree is: " << (int)floor(1.44*log2(input+2)-0.328) << endl;
+	cout << "The maximum height of the tree is: " << maxHeight(input) << endl;
 
 	return 0;
 }
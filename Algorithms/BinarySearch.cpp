@@ -1,35 +1,187 @@
 //a naive imperative implementation of binary search
+//the search itself, and the batched versions, live in BinarySearch.h
 
 //standard library to handle input output
 #include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+
+#include "BinarySearch.h"
+#include "SearchKernels.h"
+#include "LearnedIndex.h"
 
 using namespace std;
 
-//function to find the index of given element
-//runs in 0(log n) time, and has an auxiliary space complexity of 0(1)
-int BinarySearch(int a[], int left, int right, int x){
-    while(left<=right){
-        int middle = left + (right - left)/2;
+//time a search over all queries, returns nanoseconds per query
+template <class F>
+double TimePerQuery(F&& search, int q){
+    auto start = chrono::steady_clock::now();
+    search();
+    auto stop = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(stop - start).count() / q;
+}
+
+//compare a loop of single BinarySearch calls with the batch APIs
+//n should be well past the last level cache for the batching to matter, the default is 512 MiB of ints
+int Benchmark(int logN, int q){
+    const int n = 1 << logN;
+    vector<int> a(n);
+    for(int i = 0; i < n; i++){
+        a[i] = 2 * i; //only even keys, so odd queries miss
+    }
+
+    mt19937 rng(42);
+    uniform_int_distribution<int> dist(0, 2 * n);
+    vector<int> queries(q);
+    for(int i = 0; i < q; i++){
+        queries[i] = dist(rng);
+    }
+
+    vector<int> expected(q), results(q);
+    double single = TimePerQuery([&]{
+        for(int i = 0; i < q; i++){
+            expected[i] = BinarySearch(a.data(), 0, n - 1, queries[i]);
+        }
+    }, q);
+    double batch = TimePerQuery([&]{
+        BinarySearchBatch(a.data(), n, queries.data(), results.data(), q);
+    }, q);
+    bool batchOk = results == expected;
+    double sorted = TimePerQuery([&]{
+        BinarySearchSortedBatch(a.data(), n, queries.data(), results.data(), q);
+    }, q);
+    bool sortedOk = results == expected;
+
+    cout << "n = " << n << " (" << (sizeof(int) * (size_t)n >> 20) << " MiB), " << q << " queries" << endl;
+    cout << "single calls:        " << single << " ns/query" << endl;
+    cout << "interleaved batch:   " << batch << " ns/query" << (batchOk ? "" : "  MISMATCH") << endl;
+    cout << "sorted gallop batch: " << sorted << " ns/query" << (sortedOk ? "" : "  MISMATCH") << endl;
+
+    //the single query kernels, each over its own layout of the same array
+    bool layoutsOk = true;
+    auto timeLayout = [&](const char* name, auto& layout){
+        double t = TimePerQuery([&]{
+            for(int i = 0; i < q; i++){
+                results[i] = layout.Find(queries[i]);
+            }
+        }, q);
+        bool ok = results == expected;
+        layoutsOk = layoutsOk && ok;
+        cout << name << ": " << t << " ns/query, " << (layout.Bytes() >> 20) << " MiB extra"
+             << (ok ? "" : "  MISMATCH") << endl;
+    };
 
-        if(a[middle] == x)
-            return middle;
-        else if(a[middle] < x)
-            left = middle + 1;
-        else
-            right = middle - 1;
+    double branchy = TimePerQuery([&]{
+        for(int i = 0; i < q; i++){
+            results[i] = BranchySearch(a.data(), n, queries[i]);
+        }
+    }, q);
+    cout << "branchy template:    " << branchy << " ns/query" << endl;
+
+    SortedLayout<int> sortedLayout(a.data(), n);
+    timeLayout("branchless sorted   ", sortedLayout);
+    EytzingerLayout<int> eytzinger(a.data(), n);
+    timeLayout("eytzinger           ", eytzinger);
+    const SearchKernel kernels[] = { SearchKernel::Scalar, SearchKernel::Avx2, SearchKernel::Avx512 };
+    for(SearchKernel k : kernels){
+        if(!KernelSupported<int>(k))
+            continue;
+        KAryLayout<int> kary(a.data(), n, k);
+        string name = string("17-ary ") + KernelName(k);
+        name.resize(20, ' ');
+        timeLayout(name.c_str(), kary);
     }
+    cout << "runtime dispatch picks the " << KernelName(BestKernel<int>()) << " node kernel" << endl;
 
-    return -1;
+    return (batchOk && sortedOk && layoutsOk) ? 0 : 1;
 }
 
+//compare the value based strategies with BinarySearch on nearly uniform random keys
+//reports build time and size for the PGM index, and lookup latency for everything
+int LearnedBenchmark(int logN, int q){
+    const int n = 1 << logN;
+    mt19937 rng(7);
+    uniform_int_distribution<int> dist(0, 2000000000);
+    vector<int> a(n);
+    for(int i = 0; i < n; i++){
+        a[i] = dist(rng);
+    }
+    sort(a.begin(), a.end());
+
+    //half the queries are keys in the array, half are random and mostly miss
+    vector<int> queries(q);
+    for(int i = 0; i < q; i++){
+        queries[i] = (i % 2) ? a[rng() % n] : dist(rng);
+    }
+
+    vector<int> expected(q), results(q);
+    double binary = TimePerQuery([&]{
+        for(int i = 0; i < q; i++){
+            expected[i] = BinarySearch(a.data(), 0, n - 1, queries[i]);
+        }
+    }, q);
+    //BinarySearch may land on any copy of a duplicate key, the others return the first
+    for(int i = 0; i < q; i++){
+        if(expected[i] != -1)
+            expected[i] = lower_bound(a.begin(), a.end(), queries[i]) - a.begin();
+    }
+
+    auto start = chrono::steady_clock::now();
+    PgmIndex<int> pgm(a.data(), n);
+    double buildMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    bool ok = true;
+    auto report = [&](const char* name, double t){
+        bool match = results == expected;
+        ok = ok && match;
+        cout << name << t << " ns/query" << (match ? "" : "  MISMATCH") << endl;
+    };
+
+    cout << "n = " << n << " nearly uniform keys, " << q << " queries" << endl;
+    cout << "pgm index: built in " << buildMs << " ms, " << pgm.Segments() << " segments, "
+         << pgm.Levels() << " levels, " << pgm.Bytes() << " bytes" << endl;
+    cout << "BinarySearch:        " << binary << " ns/query" << endl;
+    report("pgm index:           ", TimePerQuery([&]{
+        for(int i = 0; i < q; i++){
+            results[i] = pgm.Find(queries[i]);
+        }
+    }, q));
+    report("interpolation:       ", TimePerQuery([&]{
+        for(int i = 0; i < q; i++){
+            results[i] = InterpolationSearch(a.data(), n, queries[i]);
+            if(results[i] != -1)
+                results[i] = lower_bound(a.begin(), a.begin() + results[i], queries[i]) - a.begin();
+        }
+    }, q));
+    report("exponential:         ", TimePerQuery([&]{
+        for(int i = 0; i < q; i++){
+            results[i] = ExponentialSearch(a.data(), n, queries[i]);
+        }
+    }, q));
+
+    return ok ? 0 : 1;
+}
 
 //driver code
-int main(){
+//run with "bench [log2 n] [queries]" to benchmark the batch APIs, kernels and learned index instead
+int main(int argc, char* argv[]){
+    if(argc > 1 && strcmp(argv[1], "bench") == 0){
+        int logN = argc > 2 ? atoi(argv[2]) : 27;
+        int q = argc > 3 ? atoi(argv[3]) : 1 << 20;
+        return Benchmark(logN, q) | LearnedBenchmark(logN, q);
+    }
+
     int sortedArr[] = {1,2,3,4,5,6,7,8,9,10};
     int n = sizeof(sortedArr)/sizeof(sortedArr[0]);
     int target = 3;
 
-    int result = BinarySearch(sortedArr, 0, n, target);
+    //right is the last valid index, not n
+    int result = BinarySearch(sortedArr, 0, n - 1, target);
 
     if(result == -1){
         cout << "Target not found\n";
@@ -38,4 +190,4 @@ int main(){
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,113 @@
+#ifndef BINARY_SEARCH_H
+#define BINARY_SEARCH_H
+
+//binary search over a sorted int array, one query at a time and in batches
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+//function to find the index of given element
+//runs in 0(log n) time, and has an auxiliary space complexity of 0(1)
+//left and right are both inclusive, so a whole array of n elements is searched with (0, n - 1)
+inline int BinarySearch(const int a[], int left, int right, int x){
+    while(left<=right){
+        int middle = left + (right - left)/2;
+
+        if(a[middle] == x)
+            return middle;
+        else if(a[middle] < x)
+            left = middle + 1;
+        else
+            right = middle - 1;
+    }
+
+    return -1;
+}
+
+//number of searches advanced together by BinarySearchBatch
+const int kBatchLanes = 16;
+
+//prefetch hint, a no-op on compilers without the builtin
+inline void PrefetchRead(const void* p){
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(p, 0, 1);
+#else
+    (void)p;
+#endif
+}
+
+/*
+    Answer q queries against the sorted array a[0..n) at once, results[i] gets the index
+    of queries[i] or -1, the same contract as BinarySearch.
+
+    A single search is a chain of dependent loads, so on arrays larger than the cache it waits
+    on memory at every level. Here kBatchLanes independent searches run in lockstep:
+    every lane does one branchless halving step, then prefetches its next probe, and by the time
+    the loop comes back around to it that probe has arrived. Since every lane of an array of
+    size n takes the same number of steps, the lanes never diverge.
+    Still 0(log n) per query, 0(1) auxiliary space.
+*/
+inline void BinarySearchBatch(const int a[], int n, const int queries[], int results[], int q){
+    if(n <= 0){
+        std::fill(results, results + q, -1);
+        return;
+    }
+
+    for(int start = 0; start < q; start += kBatchLanes){
+        const int lanes = std::min(kBatchLanes, q - start);
+        const int* x = queries + start;
+        int base[kBatchLanes] = {0};
+
+        int len = n;
+        while(len > 1){
+            const int half = len / 2;
+            len -= half;
+            for(int l = 0; l < lanes; l++){
+                base[l] = (a[base[l] + half] < x[l]) ? base[l] + half : base[l];
+                PrefetchRead(a + base[l] + len / 2);
+            }
+        }
+
+        //base is now the last element below the query, or 0, so the lower bound is one step away
+        for(int l = 0; l < lanes; l++){
+            const int lower = base[l] + (a[base[l]] < x[l]);
+            results[start + l] = (lower < n && a[lower] == x[l]) ? lower : -1;
+        }
+    }
+}
+
+/*
+    Same contract as BinarySearchBatch, but sorts the queries first and sweeps the array once.
+    Each query gallops forward from the position of the previous one (1, 2, 4, ... elements)
+    and then binary searches the last gap, so a query that lands d elements further on costs
+    0(log d) and all probes move forward through memory.
+    Best when queries are dense relative to n. 0(q log q) for the sort plus 0(q log(n/q)) for the sweep.
+*/
+inline void BinarySearchSortedBatch(const int a[], int n, const int queries[], int results[], int q){
+    std::vector<std::pair<int, int>> order(q);
+    for(int i = 0; i < q; i++){
+        order[i] = std::make_pair(queries[i], i);
+    }
+    std::sort(order.begin(), order.end());
+
+    int lo = 0;
+    for(int i = 0; i < q; i++){
+        const int x = order[i].first;
+
+        //gallop until a[lo + step] >= x or we run off the end
+        int step = 1;
+        while(lo + step < n && a[lo + step] < x){
+            step *= 2;
+        }
+        //everything up to lo + step/2 is below x, so the lower bound is in [first, last]
+        const int first = (step == 1) ? lo : lo + step / 2 + 1;
+        const int last = std::min(lo + step, n);
+        const int lower = std::lower_bound(a + first, a + last, x) - a;
+        lo = lower;
+
+        results[order[i].second] = (lower < n && a[lower] == x) ? lower : -1;
+    }
+}
+
+#endif
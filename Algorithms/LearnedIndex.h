@@ -0,0 +1,240 @@
+#ifndef LEARNED_INDEX_H
+#define LEARNED_INDEX_H
+
+/*
+    Search strategies that use the values of the keys, not just their order, all with the
+    BinarySearch contract of returning the index of x or -1.
+
+    - InterpolationSearch: guesses the position of x from the values at both ends of the range,
+      0(log log n) on uniform keys; a bisection step is taken whenever a guess fails to halve
+      the range, so skewed keys still cost 0(log n) instead of 0(n)
+    - ExponentialSearch: gallops 1, 2, 4, ... from a starting position and then binary searches
+      the last gap, 0(log d) where d is the distance from the start to the answer
+    - PgmIndex: a piecewise linear model of key -> position, fitted so that every key is predicted
+      within Epsilon positions of where it really is. The segments are indexed the same way,
+      recursively, so a lookup is one short bounded search per level; in the spirit of the PGM index
+      of Ferragina and Vinciguerra. On nearly uniform keys a handful of segments cover the whole array.
+
+    The key type needs operator< and a conversion to double.
+*/
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+//lower bound of x, galloping away from hint in whichever direction x lies
+//the index type comes from n, int or a 64 bit integer for arrays past 2^31 keys
+template <class T, class I>
+I ExponentialLowerBound(const T a[], I n, const T& x, I hint){
+    if(n <= 0)
+        return 0;
+    hint = std::min<I>(std::max<I>(hint, 0), n - 1);
+
+    if(a[hint] < x){
+        //everything up to hint + step/2 is below x
+        I step = 1;
+        while(hint + step < n && a[hint + step] < x){
+            step *= 2;
+        }
+        const I first = hint + step / 2 + 1;
+        const I last = std::min(hint + step, n);
+        return (I)(std::lower_bound(a + first, a + last, x) - a);
+    }
+
+    //everything from hint - step/2 onwards is at or above x
+    I step = 1;
+    while(hint - step >= 0 && !(a[hint - step] < x)){
+        step *= 2;
+    }
+    const I first = std::max<I>(hint - step, 0);
+    const I last = hint - step / 2;
+    return (I)(std::lower_bound(a + first, a + last, x) - a);
+}
+
+template <class T, class I>
+I ExponentialSearch(const T a[], I n, const T& x, I hint = 0){
+    const I lower = ExponentialLowerBound(a, n, x, hint);
+    return (lower < n && !(x < a[lower])) ? lower : -1;
+}
+
+template <class T, class I>
+I InterpolationSearch(const T a[], I n, const T& x){
+    I lo = 0, hi = n - 1;
+    bool bisect = false;
+    while(lo <= hi && !(x < a[lo]) && !(a[hi] < x)){
+        const I width = hi - lo;
+        I pos;
+        if(bisect || !(a[lo] < a[hi])){
+            pos = lo + width / 2;
+        } else {
+            const double span = (double)a[hi] - (double)a[lo];
+            pos = lo + (I)(((double)x - (double)a[lo]) / span * width);
+        }
+
+        if(a[pos] < x)
+            lo = pos + 1;
+        else if(x < a[pos])
+            hi = pos - 1;
+        else
+            return pos;
+
+        //a guess that left more than half of the range is not paying for itself
+        bisect = !bisect && (hi - lo) * 2 > width;
+    }
+    return -1;
+}
+
+template <class T, int Epsilon = 32>
+class PgmIndex {
+public:
+    PgmIndex(const T a[], int n) : a_(a), n_(n) {
+        if(n <= 0)
+            return;
+
+        //the bottom level models the first position of every distinct key
+        std::vector<T> keys;
+        std::vector<int> positions;
+        for(int i = 0; i < n; i++){
+            if(i == 0 || a[i - 1] < a[i]){
+                keys.push_back(a[i]);
+                positions.push_back(i);
+            }
+        }
+        levels_.push_back(Fit(keys, positions));
+
+        //every level above models the keys of the segments below it, until one segment is left
+        //or the keys get too close together as doubles to fit any fewer
+        while(levels_.back().size() > 1){
+            const std::vector<Segment>& below = levels_.back();
+            keys.clear();
+            positions.clear();
+            for(size_t i = 0; i < below.size(); i++){
+                keys.push_back(below[i].key);
+                positions.push_back((int)i);
+            }
+            std::vector<Segment> above = Fit(keys, positions);
+            if(above.size() == below.size())
+                break;
+            levels_.push_back(above);
+        }
+    }
+
+    int Find(const T& x) const {
+        const int lower = LowerBound(x);
+        return (lower < n_ && !(x < a_[lower])) ? lower : -1;
+    }
+
+    int LowerBound(const T& x) const {
+        if(n_ <= 0)
+            return 0;
+
+        //walk down the levels, each one predicts the segment to use in the level below
+        const std::vector<Segment>& top = levels_.back();
+        size_t s = LastSegmentAtOrBelow(top, x, (int)top.size() / 2, (int)top.size());
+        for(size_t level = levels_.size() - 1; level > 0; level--){
+            const std::vector<Segment>& below = levels_[level - 1];
+            const int p = Predict(levels_[level], s, x, (int)below.size());
+            s = LastSegmentAtOrBelow(below, x, p, Epsilon + 1);
+        }
+
+        //the bottom segment predicts the position in the array itself
+        const int p = Predict(levels_[0], s, x, n_);
+        const int first = std::max(p - Epsilon - 1, 0);
+        const int last = std::min(p + Epsilon + 2, n_);
+        const int lower = std::lower_bound(a_ + first, a_ + last, x) - a_;
+
+        //duplicate runs or rounding can push the answer out of the window, gallop to it
+        if((lower == first && first > 0 && !(a_[first - 1] < x)) || (lower == last && last < n_))
+            return ExponentialLowerBound(a_, n_, x, lower);
+        return lower;
+    }
+
+    size_t Segments() const { return levels_.empty() ? 0 : levels_[0].size(); }
+    size_t Levels() const { return levels_.size(); }
+
+    size_t Bytes() const {
+        size_t bytes = 0;
+        for(size_t i = 0; i < levels_.size(); i++){
+            bytes += levels_[i].size() * sizeof(Segment);
+        }
+        return bytes;
+    }
+
+private:
+    //position = start + slope * (x - key), for x from key up to the next segment's key
+    struct Segment {
+        T key;
+        double slope;
+        int start;
+    };
+
+    /*
+        Greedy shrinking cone: a segment starts at its first point, and every further point
+        narrows the range of slopes that keep all points so far within Epsilon of the line.
+        When the range becomes empty the segment closes with a slope from the middle of the last
+        non-empty range, and the point starts the next segment. One pass, 0(n).
+    */
+    static std::vector<Segment> Fit(const std::vector<T>& keys, const std::vector<int>& positions){
+        std::vector<Segment> segments;
+        size_t i = 0;
+        while(i < keys.size()){
+            const double x0 = (double)keys[i];
+            const double y0 = positions[i];
+            double lo = 0, hi = 1e300;
+            size_t j = i + 1;
+            for(; j < keys.size(); j++){
+                const double dx = (double)keys[j] - x0;
+                if(dx <= 0)
+                    break; //keys too close to tell apart as doubles, let the next segment take it
+                const double dy = positions[j] - y0;
+                const double segLo = std::max(lo, (dy - Epsilon) / dx);
+                const double segHi = std::min(hi, (dy + Epsilon) / dx);
+                if(segLo > segHi)
+                    break;
+                lo = segLo;
+                hi = segHi;
+            }
+            const double slope = (j == i + 1) ? 0 : (hi >= 1e300 ? lo : (lo + hi) / 2);
+            Segment seg = { keys[i], slope, positions[i] };
+            segments.push_back(seg);
+            i = j;
+        }
+        return segments;
+    }
+
+    //predicted position of x from segment s, kept inside the segment's own range of positions
+    static int Predict(const std::vector<Segment>& level, size_t s, const T& x, int size){
+        const Segment& seg = level[s];
+        double p = seg.start + seg.slope * ((double)x - (double)seg.key);
+        const double end = (s + 1 < level.size()) ? level[s + 1].start : size - 1;
+        p = std::min(std::max(p, (double)seg.start), end);
+        return (int)p;
+    }
+
+    //index of the last segment whose key is <= x, searched within radius of the prediction p
+    static size_t LastSegmentAtOrBelow(const std::vector<Segment>& level, const T& x, int p, int radius){
+        const int size = (int)level.size();
+        int first = std::max(p - radius, 0);
+        int last = std::min(p + radius + 1, size);
+
+        //upper bound within the window, widening it if the answer lies outside
+        while(first > 0 && x < level[first].key){
+            first = std::max(first - 2 * Epsilon, 0);
+        }
+        while(last < size && !(x < level[last - 1].key)){
+            last = std::min(last + 2 * Epsilon, size);
+        }
+        const int upper = std::upper_bound(level.begin() + first, level.begin() + last, x, KeyBelow) - level.begin();
+        return upper > 0 ? upper - 1 : 0;
+    }
+
+    static bool KeyBelow(const T& x, const Segment& seg){
+        return x < seg.key;
+    }
+
+    std::vector<std::vector<Segment>> levels_;
+    const T* a_;
+    int n_;
+};
+
+#endif
@@ -0,0 +1,431 @@
+/*
+    Benchmark harness for the search algorithms over sorted int arrays:
+    linear, BinarySearch, branchless binary, jump, exponential and interpolation search,
+    the measured counterpart of the complexity discussion in final-exam/question3.txt.
+
+    Every combination of key distribution, array size and hit ratio gets a fixed, seeded set
+    of queries, each algorithm answers all of them, and every answer is checked for correctness.
+    One CSV line (or JSON object with --json) is printed per combination and algorithm with
+    ns/query and, where the kernel lets us read the hardware counters, branch and cache misses
+    per query. Counters that cannot be read are left empty.
+
+    usage: SearchBenchmark [--min-log N] [--max-log N] [--queries N] [--seed N]
+                           [--hits 0,0.5,1] [--json] [--file path]
+    --min-log/--max-log  array sizes 2^min .. 2^max ints, the default 2 .. 27 runs from 4 keys,
+                         where question3.txt has jump search beating binary search, to 512 MiB,
+                         past the last level cache; --max-log goes up to 40, 4 TiB
+    --file path          back the array with a memory mapped file instead of anonymous memory,
+                         so sizes past physical memory can be measured through the page cache
+    Linear search is skipped above 2^20 elements and jump search above 2^28,
+    since a full run of queries would take hours there, and BinarySearch above 2^30,
+    since it takes int bounds. The other kernels index with int64_t and run at every size.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <cmath>
+#include <cerrno>
+#include <climits>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "BinarySearch.h"
+#include "SearchKernels.h"
+#include "LearnedIndex.h"
+
+using namespace std;
+
+//branch and cache miss counters for the calling thread, through perf_event_open
+class PerfCounters {
+public:
+    PerfCounters() : branchFd_(-1), cacheFd_(-1) {
+#ifdef __linux__
+        branchFd_ = Open(PERF_COUNT_HW_BRANCH_MISSES, -1);
+        if(branchFd_ >= 0)
+            cacheFd_ = Open(PERF_COUNT_HW_CACHE_MISSES, branchFd_);
+#endif
+    }
+
+    ~PerfCounters(){
+#ifdef __linux__
+        if(cacheFd_ >= 0)
+            close(cacheFd_);
+        if(branchFd_ >= 0)
+            close(branchFd_);
+#endif
+    }
+
+    bool Available() const { return branchFd_ >= 0 && cacheFd_ >= 0; }
+
+    void Start(){
+#ifdef __linux__
+        if(Available()){
+            ioctl(branchFd_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(branchFd_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    //returns false when the counters are not available
+    bool Stop(long long& branchMisses, long long& cacheMisses){
+#ifdef __linux__
+        if(Available()){
+            ioctl(branchFd_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            uint64_t b = 0, c = 0;
+            if(read(branchFd_, &b, sizeof(b)) == sizeof(b) && read(cacheFd_, &c, sizeof(c)) == sizeof(c)){
+                branchMisses = (long long)b;
+                cacheMisses = (long long)c;
+                return true;
+            }
+        }
+#endif
+        return false;
+    }
+
+private:
+#ifdef __linux__
+    static int Open(uint64_t config, int group){
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.disabled = (group == -1);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+    }
+#endif
+
+    int branchFd_;
+    int cacheFd_;
+};
+
+//sorted int array, in anonymous memory or mapped from a file
+class KeyArray {
+public:
+    KeyArray(size_t n, const string& file) : data_(NULL), n_(n), mapped_(false) {
+        if(file.empty()){
+            owned_.resize(n);
+            data_ = owned_.data();
+            return;
+        }
+#ifdef __linux__
+        int fd = open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0 || ftruncate(fd, n * sizeof(int)) != 0)
+            throw runtime_error("cannot create " + file);
+        void* p = mmap(NULL, n * sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(p == MAP_FAILED)
+            throw runtime_error("cannot map " + file);
+        data_ = static_cast<int*>(p);
+        mapped_ = true;
+#else
+        throw runtime_error("--file needs a POSIX system");
+#endif
+    }
+
+    ~KeyArray(){
+#ifdef __linux__
+        if(mapped_)
+            munmap(data_, n_ * sizeof(int));
+#endif
+    }
+
+    int* Data() { return data_; }
+
+private:
+    vector<int> owned_;
+    int* data_;
+    size_t n_;
+    bool mapped_;
+};
+
+enum Distribution { Dense, Uniform, Skewed, Clustered };
+
+const char* DistributionName(Distribution d){
+    switch(d){
+        case Dense: return "dense";
+        case Uniform: return "uniform";
+        case Skewed: return "skewed";
+        case Clustered: return "clustered";
+    }
+    return "?";
+}
+
+/*
+    dense:     0, 2, 4, ... every other integer, so misses are the odd numbers; past 2^30 keys
+               the even ints run out and every key repeats n / 2^30 times
+    uniform:   sorted uniform random values over the whole int range
+    skewed:    sorted values of e^u for uniform u, most keys crowd the low end
+    clustered: dense runs of 64 keys separated by random gaps
+*/
+void FillKeys(int a[], int64_t n, Distribution d, mt19937_64& rng){
+    switch(d){
+        case Dense: {
+            int shift = 0;
+            while((n >> shift) > (1LL << 30)){
+                shift++;
+            }
+            for(int64_t i = 0; i < n; i++){
+                a[i] = (int)(2 * (i >> shift));
+            }
+            return;
+        }
+        case Uniform: {
+            uniform_int_distribution<int> dist(0, INT32_MAX - 1);
+            for(int64_t i = 0; i < n; i++){
+                a[i] = dist(rng);
+            }
+            break;
+        }
+        case Skewed: {
+            uniform_real_distribution<double> dist(0, 21.4);
+            for(int64_t i = 0; i < n; i++){
+                a[i] = (int)exp(dist(rng));
+            }
+            break;
+        }
+        case Clustered: {
+            const long long maxGap = max(2LL, (long long)(INT32_MAX / 2) / max<int64_t>(1, n / 64));
+            uniform_int_distribution<long long> gap(1, maxGap);
+            long long key = 0;
+            for(int64_t i = 0; i < n; i++){
+                key += (i % 64 == 0) ? gap(rng) : 1;
+                a[i] = (int)min(key, (long long)INT32_MAX - 1);
+            }
+            return;
+        }
+    }
+    sort(a, a + n);
+}
+
+//queries where a fraction hitRatio are keys of the array and the rest are values that are not
+vector<int> MakeQueries(const int a[], int64_t n, int q, double hitRatio, mt19937_64& rng){
+    uniform_real_distribution<double> coin(0, 1);
+    uniform_int_distribution<int64_t> index(0, n - 1);
+    uniform_int_distribution<int> value(0, INT32_MAX);
+    vector<int> queries(q);
+    for(int i = 0; i < q; i++){
+        if(coin(rng) < hitRatio){
+            queries[i] = a[index(rng)];
+            continue;
+        }
+        //misses are drawn between neighbouring keys when there is a gap, otherwise anywhere
+        int x = value(rng);
+        for(int tries = 0; tries < 64 && binary_search(a, a + n, x); tries++){
+            int64_t j = index(rng);
+            x = (j + 1 < n && a[j + 1] - a[j] > 1) ? a[j] + 1 : value(rng);
+        }
+        queries[i] = binary_search(a, a + n, x) ? -1 : x;
+    }
+    return queries;
+}
+
+//how the probes per query grow with n, used to scale down the query count of slow algorithms
+enum Growth { LinearGrowth, SqrtGrowth, LogGrowth };
+
+struct Algorithm {
+    const char* name;
+    int maxLog; //largest log2 n it is run at
+    Growth growth;
+    int64_t (*search)(const int a[], int64_t n, const int& x);
+};
+
+int64_t BinarySearchKernel(const int a[], int64_t n, const int& x){ return BinarySearch(a, 0, (int)n - 1, x); }
+int64_t LinearKernel(const int a[], int64_t n, const int& x){ return LinearSearch(a, n, x); }
+int64_t BranchlessKernel(const int a[], int64_t n, const int& x){ return BranchlessSearch(a, n, x); }
+int64_t ExponentialKernel(const int a[], int64_t n, const int& x){ return ExponentialSearch(a, n, x); }
+int64_t InterpolationKernel(const int a[], int64_t n, const int& x){ return InterpolationSearch(a, n, x); }
+
+//the step only depends on the array size, so it is worked out once per size, not per query
+int64_t JumpKernel(const int a[], int64_t n, const int& x){
+    static int64_t stepFor = -1, step = 1;
+    if(n != stepFor){
+        step = JumpStep(n);
+        stepFor = n;
+    }
+    return JumpSearch(a, n, x, step);
+}
+
+const Algorithm kAlgorithms[] = {
+    { "linear", 20, LinearGrowth, &LinearKernel },
+    { "binary", 30, LogGrowth, &BinarySearchKernel },
+    { "branchless", 40, LogGrowth, &BranchlessKernel },
+    { "jump", 28, SqrtGrowth, &JumpKernel },
+    { "exponential", 40, LogGrowth, &ExponentialKernel },
+    { "interpolation", 40, LogGrowth, &InterpolationKernel },
+};
+
+struct Options {
+    int minLog = 2;
+    int maxLog = 27;
+    int queries = 1 << 20;
+    unsigned long long seed = 42;
+    vector<double> hits = { 0.0, 0.5, 1.0 };
+    bool json = false;
+    string file;
+};
+
+const char* kUsage =
+    "usage: SearchBenchmark [--min-log N] [--max-log N] [--queries N] [--seed N]\n"
+    "                       [--hits 0,0.5,1] [--json] [--file path]\n"
+    "with 0 <= min-log <= max-log <= 40 and queries positive";
+
+//the whole of s as a number in lo .. hi, or throws naming the option
+long long ParseNumber(const string& option, const char* s, long long lo, long long hi){
+    char* end;
+    errno = 0;
+    long long value = strtoll(s, &end, 10);
+    if(end == s || *end != '\0' || errno != 0 || value < lo || value > hi)
+        throw invalid_argument("bad value " + string(s) + " for " + option);
+    return value;
+}
+
+Options ParseOptions(int argc, char* argv[]){
+    Options o;
+    for(int i = 1; i < argc; i++){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "--min-log" && hasValue)
+            o.minLog = (int)ParseNumber(arg, argv[++i], 0, 40);
+        else if(arg == "--max-log" && hasValue)
+            o.maxLog = (int)ParseNumber(arg, argv[++i], 0, 40);
+        else if(arg == "--queries" && hasValue)
+            o.queries = (int)ParseNumber(arg, argv[++i], 1, INT_MAX);
+        else if(arg == "--seed" && hasValue)
+            o.seed = strtoull(argv[++i], NULL, 10);
+        else if(arg == "--file" && hasValue)
+            o.file = argv[++i];
+        else if(arg == "--json")
+            o.json = true;
+        else if(arg == "--hits" && hasValue){
+            o.hits.clear();
+            string list = argv[++i];
+            size_t start = 0;
+            while(start <= list.size()){
+                size_t comma = list.find(',', start);
+                if(comma == string::npos)
+                    comma = list.size();
+                o.hits.push_back(atof(list.substr(start, comma - start).c_str()));
+                start = comma + 1;
+            }
+        } else {
+            throw invalid_argument("unknown option " + arg);
+        }
+    }
+    if(o.minLog > o.maxLog)
+        throw invalid_argument("--min-log is above --max-log");
+    return o;
+}
+
+//one result line, counters below zero were not available
+void Emit(const Options& o, Distribution d, int64_t n, double hit, const char* algorithm, int q,
+    double nsPerQuery, double branchMisses, double cacheMisses, bool correct)
+{
+    if(o.json){
+        cout << "{\"distribution\":\"" << DistributionName(d) << "\",\"n\":" << n
+             << ",\"bytes\":" << (size_t)n * sizeof(int) << ",\"hit_ratio\":" << hit
+             << ",\"algorithm\":\"" << algorithm << "\",\"queries\":" << q
+             << ",\"ns_per_query\":" << nsPerQuery;
+        cout << ",\"branch_misses_per_query\":";
+        if(branchMisses < 0) cout << "null"; else cout << branchMisses;
+        cout << ",\"cache_misses_per_query\":";
+        if(cacheMisses < 0) cout << "null"; else cout << cacheMisses;
+        cout << ",\"seed\":" << o.seed << ",\"correct\":" << (correct ? "true" : "false") << "}" << endl;
+        return;
+    }
+    cout << DistributionName(d) << "," << n << "," << (size_t)n * sizeof(int) << "," << hit << ","
+         << algorithm << "," << q << "," << nsPerQuery << ",";
+    if(branchMisses >= 0) cout << branchMisses;
+    cout << ",";
+    if(cacheMisses >= 0) cout << cacheMisses;
+    cout << "," << o.seed << "," << (correct ? 1 : 0) << endl;
+}
+
+int main(int argc, char* argv[]){
+    Options o;
+    try {
+        o = ParseOptions(argc, argv);
+    } catch(const exception& e){
+        cerr << e.what() << endl << kUsage << endl;
+        return 2;
+    }
+
+    PerfCounters counters;
+    if(!counters.Available())
+        cerr << "hardware counters unavailable, miss columns left empty" << endl;
+
+    if(!o.json)
+        cout << "distribution,n,bytes,hit_ratio,algorithm,queries,ns_per_query,"
+                "branch_misses_per_query,cache_misses_per_query,seed,correct" << endl;
+
+    bool allCorrect = true;
+    const Distribution distributions[] = { Dense, Uniform, Skewed, Clustered };
+    for(int logN = o.minLog; logN <= o.maxLog; logN++){
+        const int64_t n = (int64_t)1 << logN;
+        KeyArray keys(n, o.file);
+        int* a = keys.Data();
+
+        for(Distribution d : distributions){
+            //the same seed for the same configuration, whatever else is run
+            mt19937_64 rng(o.seed ^ ((unsigned long long)logN << 32) ^ ((unsigned long long)d << 48));
+            FillKeys(a, n, d, rng);
+
+            for(double hit : o.hits){
+                vector<int> queries = MakeQueries(a, n, o.queries, hit, rng);
+                vector<int64_t> results(o.queries);
+
+                for(const Algorithm& algorithm : kAlgorithms){
+                    if(logN > algorithm.maxLog)
+                        continue;
+                    //slow algorithms get fewer queries on big arrays, about 2^28 probes per run
+                    long long probes = 1;
+                    if(algorithm.growth == LinearGrowth)
+                        probes = n;
+                    else if(algorithm.growth == SqrtGrowth)
+                        probes = (long long)sqrt((double)n);
+                    int q = (int)max(1LL, min((long long)o.queries, (1LL << 28) / max(1LL, probes)));
+
+                    long long branchMisses = -1, cacheMisses = -1;
+                    counters.Start();
+                    auto start = chrono::steady_clock::now();
+                    for(int i = 0; i < q; i++){
+                        results[i] = algorithm.search(a, n, queries[i]);
+                    }
+                    auto stop = chrono::steady_clock::now();
+                    bool counted = counters.Stop(branchMisses, cacheMisses);
+
+                    //any index of a matching key is a correct answer
+                    bool correct = true;
+                    for(int i = 0; i < q && correct; i++){
+                        bool present = binary_search(a, a + n, queries[i]);
+                        correct = present ? (results[i] >= 0 && a[results[i]] == queries[i]) : results[i] == -1;
+                    }
+                    allCorrect = allCorrect && correct;
+
+                    double ns = chrono::duration<double, nano>(stop - start).count() / q;
+                    Emit(o, d, n, hit, algorithm.name, q, ns,
+                        counted ? (double)branchMisses / q : -1, counted ? (double)cacheMisses / q : -1, correct);
+                }
+            }
+        }
+    }
+
+    return allCorrect ? 0 : 1;
+}
@@ -0,0 +1,357 @@
+#ifndef SEARCH_KERNELS_H
+#define SEARCH_KERNELS_H
+
+/*
+    A family of search kernels over sorted arrays, all with the BinarySearch contract:
+    return the index of x in the sorted array, or -1 if it is not there.
+
+    The kernels come with the memory layout they search, and every layout has the same
+    Find(x) interface, so callers can swap one for another:
+    - SortedLayout: the array as is, searched by a branchless lower bound where the
+      halving step is a conditional move, so there is no data dependent branch to mispredict
+    - EytzingerLayout: a copy in breadth first (heap) order, the next few levels of the search
+      are contiguous in memory and get prefetched together
+    - KAryLayout: a copy in B-tree order with 16 keys per node, so a node is one cache line for
+      32 bit keys, and a step compares all 16 keys at once with AVX-512 or two AVX2 compares,
+      cutting the depth from log2(n) to log17(n)
+
+    Everything is a template over the key type, which only needs operator<. The SIMD node kernels
+    are only used for 32 bit integers, other key types get the scalar node kernel.
+    KAryLayout picks the widest node kernel the running CPU supports, see BestKernel.
+*/
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <algorithm>
+#include <cmath>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SEARCH_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+//lower bound, where the halving step compiles to a conditional move
+//the free kernels take the index type from n, int or a 64 bit integer for arrays past 2^31 keys
+template <class T, class I>
+I BranchlessLowerBound(const T a[], I n, const T& x){
+    if(n <= 0)
+        return 0;
+    const T* base = a;
+    I len = n;
+    while(len > 1){
+        const I half = len / 2;
+        base = (base[half] < x) ? base + half : base;
+        len -= half;
+    }
+    return (I)(base - a) + (*base < x);
+}
+
+template <class T, class I>
+I BranchlessSearch(const T a[], I n, const T& x){
+    const I lower = BranchlessLowerBound(a, n, x);
+    return (lower < n && !(x < a[lower])) ? lower : -1;
+}
+
+//the branchy loop of BinarySearch, generic over the key type, kept as the baseline
+template <class T, class I>
+I BranchySearch(const T a[], I n, const T& x){
+    I left = 0, right = n - 1;
+    while(left <= right){
+        I middle = left + (right - left) / 2;
+        if(a[middle] < x)
+            left = middle + 1;
+        else if(x < a[middle])
+            right = middle - 1;
+        else
+            return middle;
+    }
+    return -1;
+}
+
+//scan from the front, stopping at the first element that is not below x
+template <class T, class I>
+I LinearSearch(const T a[], I n, const T& x){
+    I i = 0;
+    while(i < n && a[i] < x){
+        i++;
+    }
+    return (i < n && !(x < a[i])) ? i : -1;
+}
+
+//floor(sqrt(n)), the block size of JumpSearch, at least 1
+template <class I>
+I JumpStep(I n){
+    I step = (I)std::sqrt((double)n);
+    while(step > 1 && step * step > n){
+        step--;
+    }
+    while((step + 1) * (step + 1) <= n){
+        step++;
+    }
+    return std::max<I>(step, 1);
+}
+
+//jump ahead step elements at a time until one is not below x, then scan the block behind it
+//0(sqrt n) comparisons with the step JumpStep(n), against 0(log n) for binary search;
+//callers searching one array many times compute the step once and pass it in
+template <class T, class I>
+I JumpSearch(const T a[], I n, const T& x, I step){
+    if(n <= 0)
+        return -1;
+    I block = 0;
+    while(block + step < n && a[block + step - 1] < x){
+        block += step;
+    }
+    const I i = block + LinearSearch(a + block, std::min(step, n - block), x);
+    return (i >= block) ? i : -1;
+}
+
+template <class T, class I>
+I JumpSearch(const T a[], I n, const T& x){
+    return JumpSearch(a, n, x, JumpStep(n));
+}
+
+//the sorted array itself, searched in place
+template <class T>
+class SortedLayout {
+public:
+    SortedLayout(const T a[], int n) : a_(a), n_(n) {}
+
+    int Find(const T& x) const { return BranchlessSearch(a_, n_, x); }
+
+    size_t Bytes() const { return 0; }
+
+private:
+    const T* a_;
+    int n_;
+};
+
+/*
+    Sorted array copied into Eytzinger (breadth first) order, 1-indexed: the children of slot k
+    are 2k and 2k+1. The search descends with k = 2k + (b[k] < x), which is branchless,
+    and prefetches the line 4 levels down, since the 16 descendants there are contiguous.
+    The layout keeps the original index of every slot so results still index the sorted array.
+*/
+template <class T>
+class EytzingerLayout {
+public:
+    EytzingerLayout(const T a[], int n) : keys_(n + 1), index_(n + 1, -1), n_(n) {
+        int next = 0;
+        Build(a, next, 1);
+    }
+
+    int Find(const T& x) const {
+        size_t k = 1;
+        while(k <= (size_t)n_){
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(keys_.data() + 16 * k);
+#endif
+            k = 2 * k + (keys_[k] < x);
+        }
+        //undo the right turns taken after the last left turn, which lands on the lower bound
+        k >>= CountTrailingOnes(k) + 1;
+        return (k != 0 && !(x < keys_[k])) ? index_[k] : -1;
+    }
+
+    size_t Bytes() const {
+        return keys_.size() * sizeof(T) + index_.size() * sizeof(int);
+    }
+
+private:
+    //in-order walk of the implicit tree hands out the sorted elements in order
+    void Build(const T a[], int& next, size_t k){
+        if(k > (size_t)n_)
+            return;
+        Build(a, next, 2 * k);
+        keys_[k] = a[next];
+        index_[k] = next;
+        next++;
+        Build(a, next, 2 * k + 1);
+    }
+
+    static int CountTrailingOnes(size_t k){
+        int count = 0;
+        while(k & 1){
+            k >>= 1;
+            count++;
+        }
+        return count;
+    }
+
+    std::vector<T> keys_;
+    std::vector<int> index_;
+    int n_;
+};
+
+//the node kernels KAryLayout can run with
+enum class SearchKernel { Scalar, Avx2, Avx512 };
+
+inline const char* KernelName(SearchKernel k){
+    switch(k){
+        case SearchKernel::Scalar: return "scalar";
+        case SearchKernel::Avx2: return "avx2";
+        case SearchKernel::Avx512: return "avx512";
+    }
+    return "?";
+}
+
+//whether a node kernel can run for key type T on this CPU
+template <class T>
+bool KernelSupported(SearchKernel k){
+    const bool simdKey = std::is_same<T, int32_t>::value;
+    switch(k){
+#ifdef SEARCH_KERNELS_X86
+        case SearchKernel::Avx2: return simdKey && __builtin_cpu_supports("avx2");
+        case SearchKernel::Avx512: return simdKey && __builtin_cpu_supports("avx512f");
+#else
+        case SearchKernel::Avx2: return false;
+        case SearchKernel::Avx512: return false;
+#endif
+        default: return true;
+    }
+}
+
+//widest node kernel the CPU supports for T
+template <class T>
+SearchKernel BestKernel(){
+    if(KernelSupported<T>(SearchKernel::Avx512))
+        return SearchKernel::Avx512;
+    if(KernelSupported<T>(SearchKernel::Avx2))
+        return SearchKernel::Avx2;
+    return SearchKernel::Scalar;
+}
+
+//keys per KAryLayout node, 16 keys make a 17-ary tree
+const int kNodeKeys = 16;
+
+//count of the keys in one node below x
+template <class T>
+int NodeRankScalar(const T keys[], const T& x){
+    int count = 0;
+    for(int i = 0; i < kNodeKeys; i++){
+        count += (keys[i] < x);
+    }
+    return count;
+}
+
+#ifdef SEARCH_KERNELS_X86
+
+__attribute__((target("avx2")))
+inline int NodeRankAvx2(const int32_t keys[], const int32_t& x){
+    const __m256i key = _mm256_set1_epi32(x);
+    const __m256i lo = _mm256_cmpgt_epi32(key, _mm256_load_si256((const __m256i*)keys));
+    const __m256i hi = _mm256_cmpgt_epi32(key, _mm256_load_si256((const __m256i*)(keys + 8)));
+    const unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(lo))
+        | ((unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(hi)) << 8);
+    return __builtin_popcount(mask);
+}
+
+__attribute__((target("avx512f")))
+inline int NodeRankAvx512(const int32_t keys[], const int32_t& x){
+    const __m512i v = _mm512_load_si512((const void*)keys);
+    return __builtin_popcount(_mm512_cmplt_epi32_mask(v, _mm512_set1_epi32(x)));
+}
+
+#endif
+
+/*
+    Sorted array copied into an implicit B-tree (an S-tree): node k holds kNodeKeys keys
+    and its children are nodes k * 17 + 1 ... k * 17 + 17. Each step ranks x among the
+    keys of one node and descends into that child, remembering the first key >= x it saw,
+    which at the bottom is the lower bound. Slots past the end of the array are padded
+    with the largest key, so any key type works without a sentinel value.
+*/
+template <class T>
+class KAryLayout {
+public:
+    KAryLayout(const T a[], int n, SearchKernel kernel = BestKernel<T>())
+        : nodes_((n + kNodeKeys - 1) / kNodeKeys), index_(nodes_.size() * kNodeKeys, n), n_(n),
+          kernel_(KernelSupported<T>(kernel) ? kernel : SearchKernel::Scalar), find_(Resolve(kernel_))
+    {
+        int next = 0;
+        if(n > 0)
+            Build(a, next, 0);
+    }
+
+    int Find(const T& x) const { return (this->*find_)(x); }
+
+    SearchKernel Kernel() const { return kernel_; }
+
+    size_t Bytes() const {
+        return nodes_.size() * sizeof(Node) + index_.size() * sizeof(int);
+    }
+
+private:
+    struct alignas(64) Node {
+        T keys[kNodeKeys];
+    };
+
+    typedef int (KAryLayout::*FindFn)(const T&) const;
+
+    template <int (*Rank)(const T[], const T&)>
+    int FindWith(const T& x) const {
+        const size_t count = nodes_.size();
+        size_t lower = index_.size();
+        size_t k = 0;
+        while(k < count){
+            const int i = Rank(nodes_[k].keys, x);
+            if(i < kNodeKeys)
+                lower = k * kNodeKeys + i;
+            k = k * (kNodeKeys + 1) + i + 1;
+        }
+        if(lower == index_.size())
+            return -1;
+        const T& found = nodes_[lower / kNodeKeys].keys[lower % kNodeKeys];
+        return (index_[lower] < n_ && !(x < found)) ? index_[lower] : -1;
+    }
+
+    static FindFn Resolve(SearchKernel kernel){
+        switch(kernel){
+#ifdef SEARCH_KERNELS_X86
+            case SearchKernel::Avx2: return SimdFind<0>(std::is_same<T, int32_t>());
+            case SearchKernel::Avx512: return SimdFind<1>(std::is_same<T, int32_t>());
+#endif
+            default: return &KAryLayout::FindWith<&NodeRankScalar<T> >;
+        }
+    }
+
+#ifdef SEARCH_KERNELS_X86
+    //the SIMD node kernels only exist for int32_t
+    template <int Wide>
+    static FindFn SimdFind(std::true_type){
+        return Wide ? &KAryLayout::FindWith<&NodeRankAvx512> : &KAryLayout::FindWith<&NodeRankAvx2>;
+    }
+
+    template <int Wide>
+    static FindFn SimdFind(std::false_type){
+        return &KAryLayout::FindWith<&NodeRankScalar<T> >;
+    }
+#endif
+
+    //in-order walk of the implicit tree hands out the sorted elements in order
+    void Build(const T a[], int& next, size_t k){
+        if(k >= nodes_.size())
+            return;
+        for(int i = 0; i < kNodeKeys; i++){
+            Build(a, next, k * (kNodeKeys + 1) + i + 1);
+            if(next < n_){
+                nodes_[k].keys[i] = a[next];
+                index_[k * kNodeKeys + i] = next;
+                next++;
+            } else {
+                nodes_[k].keys[i] = a[n_ - 1];
+            }
+        }
+        Build(a, next, k * (kNodeKeys + 1) + kNodeKeys + 1);
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<int> index_;
+    int n_;
+    SearchKernel kernel_;
+    FindFn find_;
+};
+
+#endif
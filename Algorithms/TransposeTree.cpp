@@ -1,5 +1,15 @@
 #include <iostream>
+#include <fstream>
 #include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <algorithm>
+#include <memory>
+#include <climits>
+#include <cerrno>
 
 using namespace std;
 
@@ -26,7 +36,304 @@ void transposeGraph(vector<int> adj[], vector<int> transpose[], int v){
 	}
 }
 
-int main(){
+/*
+	Out-of-core transpose, for graphs whose edge list does not fit in memory.
+
+	The input is a binary edge file of (u, v) uint32 pairs in any order.
+	The output is a CSR file laid out as:
+		uint64 vertices, uint64 edges,
+		uint64 offsets[vertices + 1],
+		uint32 targets[edges]
+	where targets[offsets[i] .. offsets[i+1]) are the sources of the edges into i,
+	i.e. the adjacency list of i in the transposed graph.
+
+	It runs in three sequential passes over the data:
+	1. count the in-degree of every vertex, which gives the CSR offsets and lets us
+	   cut the destination range into buckets that each fit the memory budget
+	2. partition the edges by destination into one on-disk bucket file per range
+	3. load one bucket at a time, counting sort it by destination, and append
+	   its targets to the CSR file, so the buckets concatenate in vertex order
+
+	Every read and write is a sequential, buffered block transfer, and the total
+	traffic is reported through IoStats.
+*/
+
+struct Edge {
+	uint32_t u;
+	uint32_t v;
+};
+
+//bytes moved to and from disk by the out-of-core transpose
+struct IoStats {
+	uint64_t bytesRead = 0;
+	uint64_t bytesWritten = 0;
+};
+
+//buffered sequential writer, flushes in blocks of its buffer size
+//close() writes out the rest and reports a failure; a writer destroyed without close(),
+//as when an exception unwinds past it, drops what is still buffered instead of throwing
+class BlockWriter {
+public:
+	BlockWriter(const string& path, size_t bufferSize, IoStats& io)
+		: out(path, ios::binary | ios::trunc), buf(max<size_t>(bufferSize, 64)), used(0), io(io)
+	{
+		if (!out)
+			throw runtime_error("cannot open " + path + " for writing");
+	}
+
+	void write(const void* data, size_t n){
+		const char* p = static_cast<const char*>(data);
+		while (n > 0){
+			size_t chunk = min(n, buf.size() - used);
+			copy(p, p + chunk, buf.data() + used);
+			used += chunk;
+			p += chunk;
+			n -= chunk;
+			if (used == buf.size())
+				flush();
+		}
+	}
+
+	void flush(){
+		if (used == 0)
+			return;
+		out.write(buf.data(), used);
+		if (!out)
+			throw runtime_error("write failed");
+		io.bytesWritten += used;
+		used = 0;
+	}
+
+	void close(){
+		flush();
+		out.close();
+		if (!out)
+			throw runtime_error("close failed");
+	}
+
+private:
+	ofstream out;
+	vector<char> buf;
+	size_t used;
+	IoStats& io;
+};
+
+//buffered sequential reader, refills in blocks of its buffer size
+class BlockReader {
+public:
+	BlockReader(const string& path, size_t bufferSize, IoStats& io)
+		: in(path, ios::binary), buf(max<size_t>(bufferSize, 64)), pos(0), len(0), io(io)
+	{
+		if (!in)
+			throw runtime_error("cannot open " + path + " for reading");
+	}
+
+	//read exactly n bytes, returns false on a clean end of file
+	bool read(void* data, size_t n){
+		char* p = static_cast<char*>(data);
+		while (n > 0){
+			if (pos == len && !refill())
+				return false;
+			size_t chunk = min(n, len - pos);
+			copy(buf.data() + pos, buf.data() + pos + chunk, p);
+			pos += chunk;
+			p += chunk;
+			n -= chunk;
+		}
+		return true;
+	}
+
+private:
+	bool refill(){
+		in.read(buf.data(), buf.size());
+		len = in.gcount();
+		pos = 0;
+		io.bytesRead += len;
+		return len > 0;
+	}
+
+	ifstream in;
+	vector<char> buf;
+	size_t pos;
+	size_t len;
+	IoStats& io;
+};
+
+//transpose the edge file into a CSR file without holding the edge list in memory
+//memoryBudget bounds the in-degree table, the I/O blocks and the bucket being transposed
+//on an error the bucket files and the partial CSR file are removed before rethrowing
+void transposeGraphExternal(const string& edgePath, int v, const string& csrPath,
+	size_t memoryBudget, IoStats& io)
+{
+	const size_t degreeBytes = sizeof(uint64_t) * (v + 1);
+	if (degreeBytes * 2 > memoryBudget)
+		throw runtime_error("memory budget too small for the vertex table");
+	const size_t work = memoryBudget - degreeBytes;
+	//pass 3 holds a bucket reader and the CSR writer, one block each, next to the bucket
+	const size_t block = max<size_t>(work / 8, 64);
+	if (work <= 2 * block)
+		throw runtime_error("memory budget too small for the I/O blocks");
+	const size_t bucketWork = work - 2 * block;
+
+	//pass 1: in-degrees, prefix summed into CSR offsets
+	vector<uint64_t> offsets(v + 1, 0);
+	{
+		BlockReader in(edgePath, block, io);
+		Edge e;
+		while (in.read(&e, sizeof(e))){
+			if (e.u >= (uint32_t)v || e.v >= (uint32_t)v)
+				throw runtime_error("edge endpoint out of range");
+			offsets[e.v + 1]++;
+		}
+	}
+	for (int i = 0; i < v; i++){
+		offsets[i + 1] += offsets[i];
+	}
+	const uint64_t edges = offsets[v];
+
+	//cut destinations into ranges whose edges and local counters fit next to the pass 3 blocks
+	//a bucket costs one Edge per edge when loaded, one target per edge when sorted
+	const size_t perEdge = sizeof(Edge) + sizeof(uint32_t);
+	vector<int> bounds(1, 0);
+	size_t cost = 0;
+	for (int i = 0; i < v; i++){
+		size_t c = (offsets[i + 1] - offsets[i]) * perEdge + sizeof(uint64_t);
+		if (c > bucketWork)
+			throw runtime_error("memory budget too small for the in-degree of a single vertex");
+		if (cost + c > bucketWork){
+			bounds.push_back(i);
+			cost = 0;
+		}
+		cost += c;
+	}
+	bounds.push_back(v);
+	const size_t buckets = bounds.size() - 1;
+
+	//pass 2: partition edges by destination, one sequential stream per bucket
+	vector<string> bucketPaths;
+	for (size_t b = 0; b < buckets; b++){
+		bucketPaths.push_back(csrPath + ".bucket" + to_string(b));
+	}
+	try {
+		{
+			const size_t bucketBlock = max<size_t>(work / (buckets + 1), 64);
+			BlockReader in(edgePath, bucketBlock, io);
+			vector<unique_ptr<BlockWriter>> out;
+			for (size_t b = 0; b < buckets; b++){
+				out.emplace_back(new BlockWriter(bucketPaths[b], bucketBlock, io));
+			}
+			Edge e;
+			while (in.read(&e, sizeof(e))){
+				size_t b = upper_bound(bounds.begin(), bounds.end(), (int)e.v) - bounds.begin() - 1;
+				out[b]->write(&e, sizeof(e));
+			}
+			for (size_t b = 0; b < buckets; b++){
+				out[b]->close();
+			}
+		}
+
+		//pass 3: transpose each bucket in memory and append it to the CSR file
+		BlockWriter csr(csrPath, block, io);
+		uint64_t header[2] = { (uint64_t)v, edges };
+		csr.write(header, sizeof(header));
+		csr.write(offsets.data(), degreeBytes);
+
+		vector<Edge> bucket;
+		vector<uint32_t> targets;
+		vector<uint64_t> cursor;
+		for (size_t b = 0; b < buckets; b++){
+			const int lo = bounds[b];
+			const int hi = bounds[b + 1];
+			const uint64_t base = offsets[lo];
+
+			bucket.resize(offsets[hi] - base);
+			{
+				BlockReader in(bucketPaths[b], block, io);
+				if (!bucket.empty() && !in.read(bucket.data(), bucket.size() * sizeof(Edge)))
+					throw runtime_error("short read from " + bucketPaths[b]);
+			}
+			remove(bucketPaths[b].c_str());
+
+			//counting sort by destination, the counts already live in offsets
+			cursor.assign(offsets.begin() + lo, offsets.begin() + hi);
+			targets.resize(bucket.size());
+			for (size_t j = 0; j < bucket.size(); j++){
+				targets[cursor[bucket[j].v - lo]++ - base] = bucket[j].u;
+			}
+			csr.write(targets.data(), targets.size() * sizeof(uint32_t));
+		}
+		csr.close();
+	} catch (...) {
+		for (const string& path : bucketPaths){
+			remove(path.c_str());
+		}
+		remove(csrPath.c_str());
+		throw;
+	}
+}
+
+//write the adjacency list out as a binary edge file
+void writeEdgeFile(vector<int> adj[], int v, const string& path, IoStats& io){
+	BlockWriter out(path, 1 << 16, io);
+	for (int i = 0; i < v; i++){
+		for (size_t j = 0; j < adj[i].size(); j++){
+			Edge e = { (uint32_t)i, (uint32_t)adj[i][j] };
+			out.write(&e, sizeof(e));
+		}
+	}
+	out.close();
+}
+
+//print a CSR file produced by transposeGraphExternal
+void printCSR(const string& path){
+	IoStats io;
+	BlockReader in(path, 1 << 16, io);
+	uint64_t header[2];
+	if (!in.read(header, sizeof(header)))
+		throw runtime_error("empty CSR file " + path);
+	vector<uint64_t> offsets(header[0] + 1);
+	vector<uint32_t> targets(header[1]);
+	if (!in.read(offsets.data(), offsets.size() * sizeof(uint64_t))
+		|| (!targets.empty() && !in.read(targets.data(), targets.size() * sizeof(uint32_t))))
+		throw runtime_error("truncated CSR file " + path);
+
+	for (uint64_t i = 0; i < header[0]; i++){
+		cout << i << " -> ";
+		for (uint64_t j = offsets[i]; j < offsets[i + 1]; j++){
+			cout << targets[j] << " ";
+		}
+		cout << endl;
+	}
+}
+
+//the whole of s as a number in [lo, hi], or false
+bool parseArg(const char* s, long long lo, long long hi, long long& value){
+	char* end;
+	errno = 0;
+	value = strtoll(s, &end, 10);
+	return end != s && *end == '\0' && errno == 0 && value >= lo && value <= hi;
+}
+
+//usage: TransposeTree [edgeFile vertices csrFile budgetMiB]
+//with no arguments, runs the in-memory and out-of-core transposes on the sample graph
+int main(int argc, char* argv[]){
+	if (argc == 5){
+		long long v, budget;
+		if (!parseArg(argv[2], 1, INT_MAX, v) || !parseArg(argv[4], 1, (long long)(SIZE_MAX >> 21), budget)){
+			cerr << "usage: TransposeTree edgeFile vertices csrFile budgetMiB, with vertices and budgetMiB positive" << endl;
+			return 2;
+		}
+		IoStats io;
+		try {
+			transposeGraphExternal(argv[1], (int)v, argv[3], (size_t)budget << 20, io);
+		} catch (const exception& e) {
+			cerr << e.what() << endl;
+			return 1;
+		}
+		cout << "read " << io.bytesRead << " bytes, wrote " << io.bytesWritten << " bytes" << endl;
+		return 0;
+	}
+
 	int v = 7;
 	vector<int> adj[v];
 	addEdge(adj, 0, 1);
@@ -49,5 +356,17 @@ int main(){
 	cout << "\nTransposed graph: \n";
 	printGraph(transpose, v);
 
+	//same transpose through disk, with a budget small enough to force several buckets
+	IoStats io;
+	writeEdgeFile(adj, v, "graph.edges", io);
+	transposeGraphExternal("graph.edges", v, "graph.csr", 2 * sizeof(uint64_t) * (v + 1) + 192, io);
+
+	cout << "\nOut-of-core transposed graph: \n";
+	printCSR("graph.csr");
+	cout << "I/O: read " << io.bytesRead << " bytes, wrote " << io.bytesWritten << " bytes" << endl;
+
+	remove("graph.edges");
+	remove("graph.csr");
+
 	return 0;
 }
@@ -4,17 +4,324 @@
 #include <memory>
 #include <algorithm>
 #include <utility>
-#include <stack>
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <type_traits>
+#include <limits>
+
+#include "../AVL-bounds.h"
+#include "compare.h"
+#include "workPool.h"
 
 namespace avl {
 
-	template <class K, class V = void>
+	//the four rotations Rebalance can make, for the stats hooks
+	enum class Rotation { L, R, LR, RL };
+
+	/*
+		Stats policies: the trees call these hooks on their hot paths,
+		NoStats has empty inline hooks, so with it (the default) the instrumentation compiles away
+		- OnAllocate(bytes): a node was made, bytes includes the shared_ptr control block
+		- OnRotate(r): Rebalance made rotation r
+		- OnUpdate(nodes): an Add or Remove finished and path copied this many nodes
+		- OnLookup(depth): a lookup visited this many nodes
+		- Allocations(): nodes made so far, the trees use it to measure path copies
+	*/
+	struct NoStats {
+		static void OnAllocate(size_t) {}
+		static void OnRotate(Rotation) {}
+		static void OnUpdate(size_t) {}
+		static void OnLookup(int) {}
+		static size_t Allocations() { return 0; }
+	};
+
+	/*
+		Counting stats, kept per thread so the hooks need no atomics,
+		Get() returns the counters of the calling thread and Reset() clears them
+		Histograms are indexed by length and the last bucket takes everything longer
+	*/
+	struct CountingStats {
+		static const int kBuckets = maxHeight(UINT64_MAX) + 2;
+
+		struct Counters {
+			size_t allocations = 0;
+			size_t allocatedBytes = 0;
+			size_t rotations[4] = {};
+			size_t updates = 0;
+			size_t pathCopyHistogram[kBuckets] = {};
+			size_t lookups = 0;
+			size_t lookupDepthHistogram[kBuckets] = {};
+		};
+
+		static Counters& Get() {
+			thread_local Counters counters;
+			return counters;
+		}
+
+		static void Reset() { Get() = Counters(); }
+
+		static void OnAllocate(size_t bytes) {
+			Counters& c = Get();
+			c.allocations++;
+			c.allocatedBytes += bytes;
+		}
+
+		static void OnRotate(Rotation r) { Get().rotations[(int)r]++; }
+
+		static void OnUpdate(size_t nodes) {
+			Counters& c = Get();
+			c.updates++;
+			c.pathCopyHistogram[nodes < (size_t)kBuckets ? nodes : kBuckets - 1]++;
+		}
+
+		static void OnLookup(int depth) {
+			Counters& c = Get();
+			c.lookups++;
+			c.lookupDepthHistogram[depth < kBuckets ? depth : kBuckets - 1]++;
+		}
+
+		static size_t Allocations() { return Get().allocations; }
+	};
+
+	/*
+		Value storage policies for the map form, a Slot holds one key-value pair and get() returns it
+		Path copying rebuilds every node on the path to a change, and every rebuilt node copies the
+		slot of the node it replaces:
+		- InlineValues keeps the pair in the node, so each path copy copies O(log n) keys and values,
+		  fine for small values
+		- SharedValues keeps the pair behind a shared immutable handle, so a path copy only copies a
+		  pointer and bumps a count, whatever the size of the value; the pair costs one more allocation
+	*/
+	struct InlineValues {
+		template <class K, class V>
+		struct Slot {
+			Slot(K k, V v) : kv(std::move(k), std::move(v)) {}
+			const std::pair<K, V> &get() const { return kv; }
+			//the memory get() reads outside the node, for FindBatch to prefetch: none
+			const void *Indirect() const { return nullptr; }
+			std::pair<K, V> kv;
+		};
+	};
+
+	struct SharedValues {
+		template <class K, class V>
+		struct Slot {
+			Slot(K k, V v) : kv(std::make_shared<const std::pair<K, V>>(std::move(k), std::move(v))) {}
+			const std::pair<K, V> &get() const { return *kv; }
+			const void *Indirect() const { return kv.get(); }
+			std::shared_ptr<const std::pair<K, V>> kv;
+		};
+	};
+
+	/*
+		Digest policies for the map form, a digest of every subtree kept in the node at its root
+		- NoDigest keeps nothing
+		- EntryDigest keeps the sum, mod 2^64, of a 64 bit hash of each key-value pair in the subtree,
+		  hash(key, value) + left digest + right digest, worked out in MakeNode from the children.
+		  A Merkle hash of the shape, hash(key, value, left, right), would tell apart two trees with
+		  the same entries built in different orders, since the shape of an AVL tree depends on the
+		  order of its updates; the sum depends only on the entries, so replicas can compare it, and
+		  the digest of any key range comes out of O(log n) nodes. Keys and values need std::hash,
+		  and it has to be the same in the processes compared.
+	*/
+	struct NoDigest {
+		struct Field {
+			template <class KV, class Node>
+			Field(const KV&, const Node*, const Node*) {}
+		};
+	};
+
+	struct EntryDigest {
+		struct Field {
+			template <class KV, class Node>
+			Field(const KV& kv, const Node* l, const Node* r)
+				: digest(Entry(kv) + (l ? l->digest : 0) + (r ? r->digest : 0)) {}
+			const uint64_t digest;
+		};
+
+		template <class K, class V>
+		static uint64_t Entry(const std::pair<K, V>& kv) {
+			return Mix(Mix(std::hash<K>()(kv.first)) + std::hash<V>()(kv.second));
+		}
+
+		//splitmix64, std::hash of an integer is the integer itself; the step keeps Mix(0) away
+		//from 0, or the entry (0, 0) would add nothing to a digest
+		static uint64_t Mix(uint64_t x) {
+			x += 0x9e3779b97f4a7c15ull;
+			x ^= x >> 30;
+			x *= 0xbf58476d1ce4e5b9ull;
+			x ^= x >> 27;
+			x *= 0x94d049bb133111ebull;
+			return x ^ (x >> 31);
+		}
+	};
+
+	/*
+		Augment policies for the map form, a monoid over the entries whose value over each subtree is
+		kept in the node at its root, worked out in MakeNode from the children like the digest, so
+		every rotation and path copy keeps it up to date and every version keeps its own
+		An augment has
+		- Value, the type of the aggregate
+		- Identity(), the aggregate of no entries
+		- Of(key, value), the aggregate of one entry
+		- Combine(a, b), associative with Identity() as identity; a holds the smaller keys, so it
+		  need not be commutative
+		NoAugment keeps nothing, SumOfValues, MinOfValues and MaxOfValues aggregate the values as a T
+	*/
+	struct NoAugment {
+		struct Value {};
+	};
+
+	template <class T>
+	struct SumOfValues {
+		typedef T Value;
+		static T Identity() { return T(); }
+		template <class K, class V>
+		static T Of(const K&, const V& value) { return value; }
+		static T Combine(const T& a, const T& b) { return a + b; }
+	};
+
+	template <class T>
+	struct MinOfValues {
+		typedef T Value;
+		static T Identity() { return std::numeric_limits<T>::max(); }
+		template <class K, class V>
+		static T Of(const K&, const V& value) { return value; }
+		static T Combine(const T& a, const T& b) { return b < a ? b : a; }
+	};
+
+	template <class T>
+	struct MaxOfValues {
+		typedef T Value;
+		static T Identity() { return std::numeric_limits<T>::lowest(); }
+		template <class K, class V>
+		static T Of(const K&, const V& value) { return value; }
+		static T Combine(const T& a, const T& b) { return a < b ? b : a; }
+	};
+
+	//the aggregate of a node's subtree, for its augment
+	template <class Augment>
+	struct AugmentField {
+		template <class KV, class Node>
+		AugmentField(const KV& kv, const Node* l, const Node* r)
+			: aggregate(Augment::Combine(Augment::Combine(l ? l->aggregate : Augment::Identity(),
+				Augment::Of(kv.first, kv.second)), r ? r->aggregate : Augment::Identity())) {}
+		const typename Augment::Value aggregate;
+	};
+
+	template <>
+	struct AugmentField<NoAugment> {
+		template <class KV, class Node>
+		AugmentField(const KV&, const Node*, const Node*) {}
+	};
+
+	//the keys between lo and hi, a null bound is no bound, and lo and hi are in the range only when closed
+	template <class K>
+	struct KeyRange {
+		const K* lo;
+		const K* hi;
+		bool closed;
+	};
+
+	/*
+		The options of a tree, as one policy type so more can be added without growing the template
+		parameter list: derive from DefaultPolicy and override only what you need, e.g.
+		struct Counted : avl::DefaultPolicy { typedef avl::CountingStats Stats; };
+		avl::AVL<int, std::string, Counted> tree;
+
+		Compare is a three-way comparator from compare.h, called once per level of a search,
+		LessCompare gives back the old operator< behavior
+		Digest is the subtree digest of the map form, and Augment its subtree aggregate
+	*/
+	struct DefaultPolicy {
+		typedef NoStats Stats;
+		typedef InlineValues Values;
+		typedef ThreeWayCompare Compare;
+		typedef NoDigest Digest;
+		typedef NoAugment Augment;
+	};
+
+	//what MemoryFootprint reports, nodes reachable from one version are unique, from more than one shared
+	struct Footprint {
+		size_t uniqueNodes = 0;
+		size_t sharedNodes = 0;
+		size_t uniqueBytes = 0;
+		size_t sharedBytes = 0;
+	};
+
+	/*
+		nodes reachable from each of the roots, counted once however many versions reach them
+		Child(node, 0 or 1) gives the children, bytes is the size of one node
+	*/
+	template <class Node, class Child>
+	Footprint FootprintOf(const std::vector<const Node*>& roots, size_t bytes, Child&& child) {
+		struct Seen { size_t version; size_t versions; };
+		std::unordered_map<const Node*, Seen> seen;
+		std::vector<const Node*> stack;
+		for (size_t v = 0; v < roots.size(); v++) {
+			if (roots[v] != nullptr) stack.push_back(roots[v]);
+			while (!stack.empty()) {
+				const Node* n = stack.back();
+				stack.pop_back();
+				auto it = seen.find(n);
+				if (it == seen.end()) {
+					seen.emplace(n, Seen{v, 1});
+				} else if (it->second.version != v) {
+					it->second.version = v;
+					it->second.versions++;
+				} else {
+					continue;
+				}
+				for (int side = 0; side < 2; side++) {
+					const Node* c = child(n, side);
+					if (c != nullptr) stack.push_back(c);
+				}
+			}
+		}
+
+		Footprint f;
+		for (auto& kv : seen) {
+			if (kv.second.versions > 1) f.sharedNodes++;
+			else f.uniqueNodes++;
+		}
+		f.uniqueBytes = f.uniqueNodes * bytes;
+		f.sharedBytes = f.sharedNodes * bytes;
+		return f;
+	}
+
+	template <class K, class V = void, class Policy = DefaultPolicy>
 	class AVL {
 		public: 
 			AVL() {}
 
-			AVL Add(K key, V value) const {
-				return AVL(AddKey(root_, std::move(key), std::move(value)));
+			/*
+				Add or replace a key, and return the new tree
+				Adding a key that is already there with an equal value (when V has ==) changes nothing,
+				and returns a tree with the same root, see SameRoot; changed, when given, is set to
+				whether the tree changed. The same holds for Remove and Upsert.
+			*/
+			AVL Add(K key, V value, bool *changed = nullptr) const {
+				const size_t before = Stats::Allocations();
+				NodePtr root = AddKey(root_, Slot(std::move(key), std::move(value)));
+				Stats::OnUpdate(Stats::Allocations() - before);
+				return Updated(std::move(root), changed);
+			}
+
+			/*
+				Set the value of key to fn(current), where current points to its value,
+				or is nullptr when the key is not in the tree, in one descent
+				e.g. counts.Upsert(word, [](const int *n) { return n ? *n + 1 : 1; })
+			*/
+			template <class F>
+			AVL Upsert(K key, F &&fn, bool *changed = nullptr) const {
+				const size_t before = Stats::Allocations();
+				NodePtr root = UpsertKey(root_, std::move(key), fn);
+				Stats::OnUpdate(Stats::Allocations() - before);
+				return Updated(std::move(root), changed);
 			}
 
 			/*
@@ -24,17 +331,92 @@ namespace avl {
 			*/
 			template <typename LikeK>
 			const V* Find(const LikeK& key) const {
-				NodePtr n = Get(root_, key);
-				return n ? &n->kv.second : nullptr;
+				const Node *n = Get(root_, key);
+				return n ? &n->kv().second : nullptr;
 			}
 
+			/*
+				Find for count keys at once, out[i] = Find(keys[i])
+				Each Find is a chain of loads that depend on each other, so on a tree bigger than the
+				cache it waits on memory at every level. FindBatch keeps kBatchLanes lookups going as
+				small state machines and steps them in turn, one level each, prefetching the node each
+				one goes to next, so by the time a lookup comes round again its node has arrived and
+				the misses of all the lanes overlap. A lane that finishes takes the next key.
+				Where the pair is outside the node, as with SharedValues, the key is a second miss
+				behind the node's, so a lane takes two steps a level: one once the node is in, to
+				prefetch the pair, and one once the pair is in, to compare.
+			*/
+			template <typename LikeK>
+			void FindBatch(const LikeK* keys, size_t count, const V** out) const {
+				struct Lane {
+					const Node *n;
+					size_t i;
+					int depth;
+					bool fetched; //the pair of n has been prefetched
+				};
+				const Node *root = root_.get();
+				if (root == nullptr) {
+					std::fill(out, out + count, nullptr);
+					return;
+				}
+				Lane lanes[kBatchLanes];
+				size_t next = 0;
+				int active = 0;
+				while (active < kBatchLanes && next < count) {
+					lanes[active++] = Lane{ root, next++, 0, false };
+				}
+				while (active > 0) {
+					for (int l = 0; l < active; ) {
+						Lane &lane = lanes[l];
+						const Node *n = lane.n;
+						if (!lane.fetched) {
+							const void *pair = n->slot.Indirect();
+							if (pair != nullptr) {
+								__builtin_prefetch(pair);
+								lane.fetched = true;
+								l++;
+								continue;
+							}
+						}
+						lane.fetched = false;
+						lane.depth++;
+						const int c = KeyCompare::Compare(n->kv().first, keys[lane.i]);
+						const Node *child = c > 0 ? n->left.get() : n->right.get();
+						if (c != 0 && child != nullptr) {
+							__builtin_prefetch(child);
+							lane.n = child;
+							l++;
+							continue;
+						}
+						out[lane.i] = c == 0 ? &n->kv().second : nullptr;
+						Stats::OnLookup(lane.depth);
+						if (next < count) {
+							lane = Lane{ root, next++, 0, false };
+							l++;
+						} else {
+							lane = lanes[--active]; //the last lane moves here and is stepped next
+						}
+					}
+				}
+			}
+
+			void FindBatch(const std::vector<K>& keys, std::vector<const V*>& out) const {
+				out.resize(keys.size());
+				FindBatch(keys.data(), keys.size(), out.data());
+			}
+
+			static const int kBatchLanes = 16;
+
 			/*
 				Take in a key as a constant reference and return
 				a new AVL tree with the key removed from it
 			*/
 			template <typename LikeK>
-			AVL Remove(const LikeK& key) const {
-				return AVL(RemoveKey(root_, key));
+			AVL Remove(const LikeK& key, bool *changed = nullptr) const {
+				const size_t before = Stats::Allocations();
+				NodePtr root = RemoveKey(root_, key);
+				Stats::OnUpdate(Stats::Allocations() - before);
+				return Updated(std::move(root), changed);
 			}
 
 			/*
@@ -46,7 +428,7 @@ namespace avl {
 			*/
 			const std::pair<K,V> *FindSmaller(const K &key) const {
 				NodePtr n = GetSmaller(root_, *key);
-				return n ? &n->kv : nullptr;
+				return n ? &n->kv() : nullptr;
 			}
 
 			//Assert if tree is empty, check against nullptr and return bool
@@ -64,6 +446,65 @@ namespace avl {
 				ForEachImplementation(root_.get(), std::forward<F>(f));
 			}
 
+			/*
+				ForEach that skips what cannot matter, with an Augment policy:
+				a subtree is only entered when enter(its aggregate) is true, and the walk stops at the
+				first key for which past(key) is true, so f sees the entries in order up to that key
+				whose subtrees all passed enter
+			*/
+			template <class Enter, class Past, class F>
+			void ForEachWhere(Enter &&enter, Past &&past, F &&f) const {
+				ForEachWhereImplementation(root_.get(), enter, past, f);
+			}
+
+			/*
+				Parallel walks on a WorkPool, WorkPool::Shared() unless one is given. The nodes never
+				change, so the two subtrees of a node are taken on at the same time with no locking,
+				down to subtrees of fewer than grain nodes (by height, at least minVerts(height) nodes),
+				which one worker walks alone.
+				- ParallelReduce: map(key, value) of each entry, combined in key order with combine,
+				  which must be associative with identity as identity
+				- ParallelForEach: f(key, value) on each entry, in no order and from many threads
+				- Filter: a tree of the entries for which keep(key, value), built in O(n) by joining
+				  the filtered subtrees around the nodes kept, the subtrees that keep everything
+				  are shared with this tree
+				- MapValues: a tree of the same shape with the values fn(key, value), in O(n)
+				keep, map and fn are called from many threads too. If one of them throws, the walk
+				skips the subtrees not started yet, waits for the ones running on other workers,
+				and rethrows it.
+				Walks on one pool from different threads run one at a time, see workPool.h.
+			*/
+			template <class R, class Map, class Combine>
+			R ParallelReduce(R identity, Map &&map, Combine &&combine,
+				size_t grain = kGrain, WorkPool &pool = WorkPool::Shared()) const {
+				R result = identity;
+				pool.Run([&] {
+					result = ReduceNode(root_.get(), identity, map, combine, Forks(grain), pool);
+				});
+				return result;
+			}
+
+			template <class F>
+			void ParallelForEach(F &&f, size_t grain = kGrain, WorkPool &pool = WorkPool::Shared()) const {
+				pool.Run([&] { ForEachNode(root_.get(), f, Forks(grain), pool); });
+			}
+
+			template <class Keep>
+			AVL Filter(Keep &&keep, size_t grain = kGrain, WorkPool &pool = WorkPool::Shared()) const {
+				NodePtr root;
+				pool.Run([&] { root = FilterNode(root_, keep, Forks(grain), pool); });
+				return AVL(std::move(root));
+			}
+
+			template <class F, class W = typename std::decay<decltype(std::declval<F &>()(std::declval<const K &>(), std::declval<const V &>()))>::type>
+			AVL<K, W, Policy> MapValues(F &&fn, size_t grain = kGrain, WorkPool &pool = WorkPool::Shared()) const {
+				typename AVL<K, W, Policy>::NodePtr root;
+				pool.Run([&] { root = MapNode<W>(root_.get(), fn, Forks(grain), pool); });
+				return AVL<K, W, Policy>(std::move(root));
+			}
+
+			static const size_t kGrain = 4096;
+
 			//check if current & trivial tree have same root
 			bool SameRoot(const AVL &avl) const {
 				return root_ == avl.root_;
@@ -83,7 +524,7 @@ namespace avl {
 						if (p == nullptr) return -1;
 						if (q == nullptr) return 1;
 
-						const int kv = QsortCompare(p->kv, q->kv);
+						const int kv = CompareEntries(p->kv(), q->kv());
 
 						if (kv != 0) return kv;
 					} else if (p == nullptr) {
@@ -94,9 +535,20 @@ namespace avl {
 				}
 			}
 
-			//comparison of two tree
+			//the same entries, keys equal by the comparator and values by ==, O(1) for the same root
 			bool operator==(const AVL& other) const {
-				return QsortCompare(*this, other) == 0;
+				if (root_ == other.root_) return true;
+				Itr a(root_);
+				Itr b(other.root_);
+				for (;;) {
+					const Node *p = a.current();
+					const Node *q = b.current();
+					if (p == nullptr || q == nullptr) return p == q;
+					if (KeyCompare::Compare(p->kv().first, q->kv().first) != 0) return false;
+					if (!(p->kv().second == q->kv().second)) return false;
+					a.MoveNext();
+					b.MoveNext();
+				}
 			}
 
 			//print tree in order
@@ -114,17 +566,97 @@ namespace avl {
 				PrintPostOrder(root_);
 			}
 
+			/*
+				unique and shared node bytes across a set of live versions,
+				e.g. AVL::MemoryFootprint(v1, v2, v3); the bytes of a node include its control block
+			*/
+			template <class... Versions>
+			static Footprint MemoryFootprint(const AVL& first, const Versions&... rest) {
+				std::vector<const Node*> roots = { first.root_.get(), rest.root_.get()... };
+				return FootprintOf(roots, kNodeBytes, [](const Node* n, int side) {
+					return side == 0 ? n->left.get() : n->right.get();
+				});
+			}
+
+			/*
+				Digests, with the EntryDigest policy: RootDigest is the same for two trees with the same
+				entries whatever their shapes, RangeDigest is the digest of the entries in a range,
+				in O(log n)
+			*/
+			uint64_t RootDigest() const {
+				return DigestOf(root_.get());
+			}
+
+			uint64_t RangeDigest(const KeyRange<K>& range) const {
+				if (range.lo && range.hi) {
+					const int c = KeyCompare::Compare(*range.lo, *range.hi);
+					if (c > 0 || (c == 0 && !range.closed)) return 0;
+				}
+				const uint64_t below = range.hi ? DigestBelow(*range.hi, range.closed) : RootDigest();
+				return below - (range.lo ? DigestBelow(*range.lo, !range.closed) : 0);
+			}
+
+			/*
+				The augment of the entries with keys in [lo, hi), with an Augment policy, in O(log n):
+				one descent to the first node in the range, then one down each side of it
+				e.g. the sum of a counter over a time window, on any version of the tree
+			*/
+			typename Policy::Augment::Value Aggregate(const K& lo, const K& hi) const {
+				static_assert(!std::is_same<Augment, NoAugment>::value, "aggregates need an Augment policy");
+				const Node* n = root_.get();
+				while (n) {
+					if (KeyCompare::Compare(n->kv().first, lo) < 0) n = n->right.get();
+					else if (KeyCompare::Compare(n->kv().first, hi) >= 0) n = n->left.get();
+					else break;
+				}
+				if (!n) return Augment::Identity();
+				return Augment::Combine(Augment::Combine(AggregateFrom(n->left.get(), lo), EntryAggregate(n)),
+					AggregateBelow(n->right.get(), hi));
+			}
+
+			//the augment of every entry
+			typename Policy::Augment::Value Aggregate() const {
+				return AggregateOf(root_.get());
+			}
+
+			/*
+				Anti-entropy against a replica: remote(range) returns the RangeDigest of the other tree
+				over an open range, and found(range) is called, in key order, with the ranges where the
+				two trees differ, a closed range of one key whose entry the other tree lacks or has
+				another value for, or an open range where this tree has no keys and the other has
+				Starting from the root, it only asks about the two halves of a subtree whose digest did
+				not match, so d differences cost O(d log n) remote calls, and equal trees one
+			*/
+			template <class Remote, class Found>
+			void Reconcile(Remote&& remote, Found&& found) const {
+				const KeyRange<K> all = { nullptr, nullptr, false };
+				const uint64_t theirs = remote(all);
+				if (theirs != RootDigest()) ReconcileNode(root_.get(), all, theirs, remote, found);
+			}
+
 		private:
+			template <class, class, class> friend class AVL;
+			template <class, class, class> friend class SmallAVL;
+
 			struct Node;
+			typedef typename Policy::Stats Stats;
+			typedef typename Policy::Compare KeyCompare;
+			typedef typename Policy::Values::template Slot<K, V> Slot;
+
+			typedef typename Policy::Digest Digest;
+			typedef typename Policy::Augment Augment;
 
 			typedef std::shared_ptr<Node> NodePtr;
-			struct Node : public std::enable_shared_from_this<Node> {
-				Node(K k, V v, NodePtr l, NodePtr r, long h)
-					: kv(std::move(k), std::move(v)),
+			struct Node : public std::enable_shared_from_this<Node>, public Digest::Field, public AugmentField<Augment> {
+				Node(Slot s, NodePtr l, NodePtr r, long h)
+					: Digest::Field(s.get(), l.get(), r.get()),
+					AugmentField<Augment>(s.get(), l.get(), r.get()),
+					slot(std::move(s)),
 					left(std::move(l)),
 					right(std::move(r)),
 					height(h) {}
-				const std::pair<K,V> kv;
+				const std::pair<K,V> &kv() const { return slot.get(); }
+				const Slot slot;
 				const NodePtr left;
 				const NodePtr right;
 				const long height;
@@ -153,10 +685,13 @@ namespace avl {
 
 				private:
 					size_t depth_{0};
-					Node *nodes_[32];
 					/*
-						max depth of 32 which is ~4 billion nodes :)
+						the iterator holds one node per level on the path from the root,
+						and no AVL tree with a 64 bit node count is taller than maxHeight(UINT64_MAX) = 90,
+						the 32 levels there used to be hold paths of trees up to height 31, which only
+						covers every tree of fewer than N(32) = 9,227,464 nodes
 					*/
+					Node *nodes_[maxHeight(UINT64_MAX) + 1];
 
 			};
 
@@ -191,21 +726,142 @@ namespace avl {
 
 			explicit AVL(NodePtr root) : root_(std::move(root)) {}
 
+			//an update that changed nothing hands back the very same root
+			AVL Updated(NodePtr root, bool *changed) const {
+				if (changed) *changed = root != root_;
+				return AVL(std::move(root));
+			}
+
+			//a == b where V has ==, otherwise values never count as equal
+			template <class T>
+			static auto SameValue(const T &a, const T &b, int) -> decltype(bool(a == b)) {
+				return a == b;
+			}
+
+			template <class T>
+			static bool SameValue(const T &, const T &, long) {
+				return false;
+			}
+
 			template <class F>
 			static void ForEachImplementation(const Node *n, F &&f) {
 				if(n == nullptr) return;
 
 				ForEachImplementation(n->left.get(), std::forward<F>(f));
-				f(const_cast<const K&>(n->kv.first), const_cast<const V&>(n->kv.second));
+				f(const_cast<const K&>(n->kv().first), const_cast<const V&>(n->kv().second));
 				ForEachImplementation(n->right.get(), std::forward<F>(f));
 			}
 
+			//false once the walk is past the keys of interest
+			template <class Enter, class Past, class F>
+			static bool ForEachWhereImplementation(const Node *n, Enter &enter, Past &past, F &f) {
+				if (n == nullptr || !enter(AggregateOf(n))) return true;
+				if (!ForEachWhereImplementation(n->left.get(), enter, past, f)) return false;
+				if (past(n->kv().first)) return false;
+				f(n->kv().first, n->kv().second);
+				return ForEachWhereImplementation(n->right.get(), enter, past, f);
+			}
+
+			//the least height of a subtree that the parallel walks split, for a grain
+			static long Forks(size_t grain) {
+				return maxHeight(grain) + 2;
+			}
+
+			//a and b in parallel when n is at least forks high, one after the other below that
+			template <class A, class B>
+			static void Fork(const Node *n, long forks, WorkPool &pool, A &&a, B &&b) {
+				if (n->height >= forks) {
+					pool.Join(a, b);
+				} else {
+					a();
+					b();
+				}
+			}
+
+			template <class R, class Map, class Combine>
+			static R ReduceNode(const Node *n, const R &identity, Map &map, Combine &combine, long forks, WorkPool &pool) {
+				if (n == nullptr) return identity;
+				if (n->height < forks) {
+					R sum = identity;
+					Fold(n, sum, map, combine);
+					return sum;
+				}
+				R left = identity, right = identity;
+				Fork(n, forks, pool,
+					[&] { left = ReduceNode(n->left.get(), identity, map, combine, forks, pool); },
+					[&] { right = ReduceNode(n->right.get(), identity, map, combine, forks, pool); });
+				return combine(combine(left, map(n->kv().first, n->kv().second)), right);
+			}
+
+			//one worker's share of a reduce, folded left to right into sum
+			template <class R, class Map, class Combine>
+			static void Fold(const Node *n, R &sum, Map &map, Combine &combine) {
+				if (n == nullptr) return;
+				Fold(n->left.get(), sum, map, combine);
+				sum = combine(sum, map(n->kv().first, n->kv().second));
+				Fold(n->right.get(), sum, map, combine);
+			}
+
+			template <class F>
+			static void ForEachNode(const Node *n, F &f, long forks, WorkPool &pool) {
+				if (n == nullptr) return;
+				f(n->kv().first, n->kv().second);
+				Fork(n, forks, pool,
+					[&] { ForEachNode(n->left.get(), f, forks, pool); },
+					[&] { ForEachNode(n->right.get(), f, forks, pool); });
+			}
+
+			template <class Keep>
+			static NodePtr FilterNode(const NodePtr &n, Keep &keep, long forks, WorkPool &pool) {
+				if (!n) return nullptr;
+				NodePtr left, right;
+				Fork(n.get(), forks, pool,
+					[&] { left = FilterNode(n->left, keep, forks, pool); },
+					[&] { right = FilterNode(n->right, keep, forks, pool); });
+				if (!keep(n->kv().first, n->kv().second)) return Join(left, right);
+				if (left == n->left && right == n->right) return n;
+				return Join(left, n->slot, right);
+			}
+
+			template <class W, class F>
+			static typename AVL<K, W, Policy>::NodePtr MapNode(const Node *n, F &fn, long forks, WorkPool &pool) {
+				typedef AVL<K, W, Policy> Mapped;
+				if (n == nullptr) return nullptr;
+				typename Mapped::NodePtr left, right;
+				Fork(n, forks, pool,
+					[&] { left = MapNode<W>(n->left.get(), fn, forks, pool); },
+					[&] { right = MapNode<W>(n->right.get(), fn, forks, pool); });
+				return Mapped::MakeNode(typename Mapped::Slot(n->kv().first, fn(n->kv().first, n->kv().second)),
+					left, right);
+			}
+
+			/*
+				left, slot and right in one tree, every key of left before slot's and of right after,
+				by walking down the side of the taller tree to a subtree as high as the other and
+				rebalancing on the way back up, O(difference in height)
+			*/
+			static NodePtr Join(const NodePtr &left, Slot slot, const NodePtr &right) {
+				if (Height(left) > Height(right) + 1)
+					return Rebalance(left->slot, left->left, Join(left->right, std::move(slot), right));
+				if (Height(right) > Height(left) + 1)
+					return Rebalance(right->slot, Join(left, std::move(slot), right->left), right->right);
+				return MakeNode(std::move(slot), left, right);
+			}
+
+			//left and right in one tree, around the last entry of left, O(height)
+			static NodePtr Join(const NodePtr &left, const NodePtr &right) {
+				if (!left) return right;
+				if (!right) return left;
+				NodePtr last = InOrderT(left);
+				return Join(RemoveKey(left, last->kv().first), last->slot, right);
+			}
+
 			//print tree in order
 			static void PrintInOrder(const NodePtr &n) {
 				if(n == nullptr) return;
 
 				PrintInOrder(n->left);
-				std::cout << n->kv.first << " ";
+				std::cout << n->kv().first << " ";
 				PrintInOrder(n->right);
 			}
 
@@ -213,7 +869,7 @@ namespace avl {
 			static void PrintPreOrder(const NodePtr &n) {
 				if(n == nullptr) return;
 
-				std::cout << n->kv.first << " ";
+				std::cout << n->kv().first << " ";
 				PrintPreOrder(n->left);
 				PrintPreOrder(n->right);
 			}
@@ -224,7 +880,7 @@ namespace avl {
 
 				PrintPostOrder(n->left);
 				PrintPostOrder(n->right);
-				std::cout << n->kv.first << " ";
+				std::cout << n->kv().first << " ";
 			}
 			
 
@@ -232,32 +888,145 @@ namespace avl {
 				return n ? n->height : 0;
 			}
 
-			static NodePtr MakeNode(K key, V value, const NodePtr &left, const NodePtr &right) {
-				return std::make_shared<Node>(std::move(key), std::move(value), left, right,
+			//a node and the shared_ptr control block make_shared puts next to it (vtable, two counts)
+			static const size_t kNodeBytes = sizeof(Node) + 2 * sizeof(void*);
+
+			static NodePtr MakeNode(Slot slot, const NodePtr &left, const NodePtr &right) {
+				Stats::OnAllocate(kNodeBytes);
+				return std::make_shared<Node>(std::move(slot), left, right,
 					1 + std::max(Height(left), Height(right)));
 			}
 
-			template <typename LikeK>
-			static NodePtr Get(const NodePtr &node, const LikeK &key) {
-				if (node == nullptr)
-				{
-					return nullptr;
+			//entries by key with the comparator, then by value with <, for QsortCompare
+			static int CompareEntries(const std::pair<K, V> &a, const std::pair<K, V> &b) {
+				const int c = KeyCompare::Compare(a.first, b.first);
+				return c != 0 ? c : LessCompare::Compare(a.second, b.second);
+			}
+
+			//a balanced tree of count slots in key order, sharing them, for SmallAVL
+			static NodePtr FromSlots(const Slot *slots, size_t count) {
+				if (count == 0) return nullptr;
+				const size_t middle = count / 2;
+				return MakeNode(slots[middle], FromSlots(slots, middle),
+					FromSlots(slots + middle + 1, count - middle - 1));
+			}
+
+			//f(slot) for each slot in key order, for SmallAVL
+			template <class F>
+			static void ForEachSlot(const Node *n, F &f) {
+				if (n == nullptr) return;
+				ForEachSlot(n->left.get(), f);
+				f(n->slot);
+				ForEachSlot(n->right.get(), f);
+			}
+
+			static uint64_t DigestOf(const Node* n) {
+				static_assert(!std::is_same<Digest, NoDigest>::value, "digests need the EntryDigest policy");
+				return n ? n->digest : 0;
+			}
+
+			//digest of the entries with keys below key, or up to and including it
+			uint64_t DigestBelow(const K& key, bool inclusive) const {
+				uint64_t sum = 0;
+				const Node* n = root_.get();
+				while (n) {
+					const int c = KeyCompare::Compare(n->kv().first, key);
+					if (c > 0) {
+						n = n->left.get();
+						continue;
+					}
+					sum += DigestOf(n->left.get());
+					if (c == 0) {
+						if (inclusive) sum += Digest::Entry(n->kv());
+						break;
+					}
+					sum += Digest::Entry(n->kv());
+					n = n->right.get();
 				}
+				return sum;
+			}
 
-				if (node -> kv.first > key) {
-					return Get(node->left, key);
-				} else if (node->kv.first < key) {
-					return Get(node->right, key);
-				} else {
-					return node;
+			static typename Augment::Value AggregateOf(const Node* n) {
+				static_assert(!std::is_same<Augment, NoAugment>::value, "aggregates need an Augment policy");
+				return n ? n->aggregate : Augment::Identity();
+			}
+
+			static typename Augment::Value EntryAggregate(const Node* n) {
+				return Augment::Of(n->kv().first, n->kv().second);
+			}
+
+			//the augment of the keys >= lo under n, each node taken comes before what was taken so far
+			static typename Augment::Value AggregateFrom(const Node* n, const K& lo) {
+				typename Augment::Value sum = Augment::Identity();
+				while (n) {
+					if (KeyCompare::Compare(n->kv().first, lo) >= 0) {
+						sum = Augment::Combine(Augment::Combine(EntryAggregate(n), AggregateOf(n->right.get())), sum);
+						n = n->left.get();
+					} else {
+						n = n->right.get();
+					}
 				}
+				return sum;
+			}
+
+			//the augment of the keys < hi under n, each node taken comes after what was taken so far
+			static typename Augment::Value AggregateBelow(const Node* n, const K& hi) {
+				typename Augment::Value sum = Augment::Identity();
+				while (n) {
+					if (KeyCompare::Compare(n->kv().first, hi) < 0) {
+						sum = Augment::Combine(sum, Augment::Combine(AggregateOf(n->left.get()), EntryAggregate(n)));
+						n = n->right.get();
+					} else {
+						n = n->left.get();
+					}
+				}
+				return sum;
+			}
+
+			//the other tree's digest of range, theirs, did not match the subtree at n
+			template <class Remote, class Found>
+			static void ReconcileNode(const Node* n, const KeyRange<K>& range, uint64_t theirs,
+				Remote& remote, Found& found) {
+				if (!n) {
+					found(range);
+					return;
+				}
+				const K* key = &n->kv().first;
+				const KeyRange<K> left = { range.lo, key, false };
+				const KeyRange<K> right = { key, range.hi, false };
+				const uint64_t theirLeft = remote(left);
+				const uint64_t theirRight = remote(right);
+				if (theirLeft != DigestOf(n->left.get())) ReconcileNode(n->left.get(), left, theirLeft, remote, found);
+				if (theirs - theirLeft - theirRight != Digest::Entry(n->kv())) found(KeyRange<K>{ key, key, true });
+				if (theirRight != DigestOf(n->right.get())) ReconcileNode(n->right.get(), right, theirRight, remote, found);
+			}
+
+			//walk down from node, counting the depth for the stats
+			template <typename LikeK>
+			static const Node *Get(const NodePtr &node, const LikeK &key) {
+				const Node *n = node.get();
+				int depth = 0;
+				while (n != nullptr) {
+					depth++;
+					const int c = KeyCompare::Compare(n->kv().first, key);
+					if (c > 0) {
+						n = n->left.get();
+					} else if (c < 0) {
+						n = n->right.get();
+					} else {
+						break;
+					}
+				}
+				Stats::OnLookup(depth);
+				return n;
 			}
 
 			static NodePtr GetSmaller(const NodePtr &node, const K &key) {
 				if (!node) return nullptr;
-				if(node->kv.first > key) {
+				const int c = KeyCompare::Compare(node->kv().first, key);
+				if (c > 0) {
 					return GetSmaller(node->left, key);
-				} else if (node->kv.first < key) {
+				} else if (c < 0) {
 					NodePtr n = GetSmaller(node->right, key);
 					if (n == nullptr) n = node;
 					return n;
@@ -266,75 +1035,107 @@ namespace avl {
 				}
 			}
 
-			static NodePtr RotateL(K key, V value, const NodePtr &left, const NodePtr &right) {
+			static NodePtr RotateL(Slot slot, const NodePtr &left, const NodePtr &right) {
 				return MakeNode(
-					right->kv.first, right->kv.second,
-					MakeNode(std::move(key), std::move(value), left, right->left),
+					right->slot,
+					MakeNode(std::move(slot), left, right->left),
 					right->right);
 			}
 
-			static NodePtr RotateR(K key, V value, const NodePtr &left, const NodePtr &right) {
+			static NodePtr RotateR(Slot slot, const NodePtr &left, const NodePtr &right) {
 				return MakeNode(
-					left->kv.first, left->kv.second, left->left,
-					MakeNode(std::move(key), std::move(value), left->right, right));
+					left->slot, left->left,
+					MakeNode(std::move(slot), left->right, right));
 			}
 
-			static NodePtr RotateLR(K key, V value, const NodePtr &left, const NodePtr &right) {
+			static NodePtr RotateLR(Slot slot, const NodePtr &left, const NodePtr &right) {
 				//rotate R (..., rotate L(left), right)
 				return MakeNode(
-					left->right->kv.first, left->right->kv.second,
-					MakeNode(left->kv.first, left->kv.second, left->left,
+					left->right->slot,
+					MakeNode(left->slot, left->left,
 						left->right->left),
-					MakeNode(std::move(key), std::move(value), left->right->right, right));
+					MakeNode(std::move(slot), left->right->right, right));
 			}
 
-			static NodePtr RotateRL(K key, V value, const NodePtr &left, const NodePtr &right) {
+			static NodePtr RotateRL(Slot slot, const NodePtr &left, const NodePtr &right) {
 				return MakeNode(
-					right->left->kv.first, 
-					right->left->kv.second,
-					MakeNode(std::move(key), std::move(value), left, right->left->left),
-					MakeNode(right->kv.first, right->kv.second, right->left->right,
+					right->left->slot,
+					MakeNode(std::move(slot), left, right->left->left),
+					MakeNode(right->slot, right->left->right,
 					right->right));
 			}
 
-			static NodePtr Rebalance(K key, V value, const NodePtr &left, const NodePtr &right) {
+			static NodePtr Rebalance(Slot slot, const NodePtr &left, const NodePtr &right) {
 				switch(Height(left) - Height(right)) {
 					case 2:
 						if (Height(left->left) - Height(left->right) == -1) {
-							return RotateLR(std::move(key), std::move(value), left, right);
+							Stats::OnRotate(Rotation::LR);
+							return RotateLR(std::move(slot), left, right);
 						} else {
-							return RotateR(std::move(key), std::move(value), left, right);
+							Stats::OnRotate(Rotation::R);
+							return RotateR(std::move(slot), left, right);
 						}
 
 					case -2:
 						if (Height(right->left) - Height(right->right) == 1) {
-							return RotateRL(std::move(key), std::move(value), left, right);
+							Stats::OnRotate(Rotation::RL);
+							return RotateRL(std::move(slot), left, right);
 						} else {
-							return RotateL(std::move(key), std::move(value), left, right);
+							Stats::OnRotate(Rotation::L);
+							return RotateL(std::move(slot), left, right);
 						}
 
 					default:
-						return MakeNode(key, value, left, right);
+						return MakeNode(std::move(slot), left, right);
+				}
+			}
+
+			static NodePtr AddKey(const NodePtr &node, Slot slot) {
+				if (!node) {
+					return MakeNode(std::move(slot), nullptr, nullptr);
 				}
+
+				//a subtree that comes back unchanged means this node is unchanged too
+				const int c = KeyCompare::Compare(node->kv().first, slot.get().first);
+				if (c < 0) {
+					NodePtr right = AddKey(node->right, std::move(slot));
+					if (right == node->right) return node;
+					return Rebalance(node->slot, node->left, std::move(right));
+				}
+
+				if (c > 0) {
+					NodePtr left = AddKey(node->left, std::move(slot));
+					if (left == node->left) return node;
+					return Rebalance(node->slot, std::move(left), node->right);
+				}
+
+				if (SameValue(slot.get().second, node->kv().second, 0)) return node;
+				return MakeNode(std::move(slot), node->left, node->right);
 			}
 
-			static NodePtr AddKey(const NodePtr &node, K key, V value) {
+			template <class F>
+			static NodePtr UpsertKey(const NodePtr &node, K key, F &fn) {
 				if (!node) {
-					return MakeNode(std::move(key), std::move(value), nullptr, nullptr);
+					V value = fn(static_cast<const V*>(nullptr));
+					return MakeNode(Slot(std::move(key), std::move(value)), nullptr, nullptr);
 				}
 
-				if (node->kv.first < key) {
-					return Rebalance(node->kv.first, node->kv.second, node->left,
-						AddKey(node->right, std::move(key), std::move(value)));
+				const int c = KeyCompare::Compare(node->kv().first, key);
+				if (c < 0) {
+					NodePtr right = UpsertKey(node->right, std::move(key), fn);
+					if (right == node->right) return node;
+					return Rebalance(node->slot, node->left, std::move(right));
 				}
 
-				if(key < node->kv.first) {
-					return Rebalance(node->kv.first, node->kv.second,
-						AddKey(node->left, std::move(key), std::move(value)),
-						node->right);
+				if (c > 0) {
+					NodePtr left = UpsertKey(node->left, std::move(key), fn);
+					if (left == node->left) return node;
+					return Rebalance(node->slot, std::move(left), node->right);
 				}
 
-				return MakeNode(std::move(key), std::move(value), node->left, node->right);
+				V value = fn(&node->kv().second);
+				if (SameValue(value, node->kv().second, 0)) return node;
+				return MakeNode(Slot(std::move(key), std::move(value)), node->left, node->right);
 			}
 
 			//in order head
@@ -356,14 +1157,18 @@ namespace avl {
 			static NodePtr RemoveKey(const NodePtr& node, const LikeK& key) {
 				if (!node) return nullptr;
 
-				if (node->kv.first < key) {
-					return Rebalance(node->kv.first, node->kv.second, node->left,
-						RemoveKey(node->right, key));
+				//a missing key leaves every node on the path as it was
+				const int c = KeyCompare::Compare(node->kv().first, key);
+				if (c < 0) {
+					NodePtr right = RemoveKey(node->right, key);
+					if (right == node->right) return node;
+					return Rebalance(node->slot, node->left, std::move(right));
 				}
 
-				if (key < node->kv.first) {
-					return Rebalance(node->kv.first, node->kv.second,
-						RemoveKey(node->left, key), node->right);
+				if (c > 0) {
+					NodePtr left = RemoveKey(node->left, key);
+					if (left == node->left) return node;
+					return Rebalance(node->slot, std::move(left), node->right);
 				}
 
 				if (!node->left) return node->right;
@@ -371,24 +1176,37 @@ namespace avl {
 
 				if (node->left->height < node->right->height) {
 					NodePtr h = InOrderH(node->right);
-					return Rebalance(h->kv.first, h->kv.second,
-						node->left, RemoveKey(node->right, h->kv.first));
+					return Rebalance(h->slot,
+						node->left, RemoveKey(node->right, h->kv().first));
 				} else {
 					NodePtr t = InOrderT(node->left);
-					return Rebalance(t->kv.first, t->kv.second,
-						RemoveKey(node->left, t->kv.first), node->right);
+					return Rebalance(t->slot,
+						RemoveKey(node->left, t->kv().first), node->right);
 				}
 			}
-			abort();
 };
 
-template <class K>
-class AVL<K, void> {
+template <class K, class Policy>
+class AVL<K, void, Policy> {
 	public:
 		AVL() {}
 
-		AVL Add(K key) const { return AVL(AddKey(root_, std::move(key))); }
-		AVL Remove(const K& key) const { return AVL(RemoveKey(root_, key)); }
+		//adding a key that is there or removing one that is not returns the same root,
+		//and changed, when given, is set to whether the set changed
+		AVL Add(K key, bool* changed = nullptr) const {
+			const size_t before = Stats::Allocations();
+			NodePtr root = AddKey(root_, std::move(key));
+			Stats::OnUpdate(Stats::Allocations() - before);
+			return Updated(std::move(root), changed);
+		}
+
+		AVL Remove(const K& key, bool* changed = nullptr) const {
+			const size_t before = Stats::Allocations();
+			NodePtr root = RemoveKey(root_, key);
+			Stats::OnUpdate(Stats::Allocations() - before);
+			return Updated(std::move(root), changed);
+		}
+
 		bool Lookup(const K& key) const { return Get(root_, key) != nullptr; }
 		bool Empty() const { return root_ == nullptr; }
 
@@ -416,14 +1234,27 @@ class AVL<K, void> {
 			PrintPostOrder(root_);
 		}
 
-		//friend function to loop & compare two trees
+		//friend function to loop & compare two trees, one root is always the same set
+		//equal sets built by different updates have different shapes, so this is O(n) for them,
+		//HashConsedSet in hashConsedSet.h is the set form where it is always O(1)
 		friend bool operator==(const AVL& tree1, const AVL& tree2) {
-			return Compare(tree1, tree2);
+			return tree1.root_ == tree2.root_ || Compare(tree1, tree2);
+		}
+
+		//unique and shared node bytes across a set of live versions, like the map form
+		template <class... Versions>
+		static Footprint MemoryFootprint(const AVL& first, const Versions&... rest) {
+			std::vector<const Node*> roots = { first.root_.get(), rest.root_.get()... };
+			return FootprintOf(roots, kNodeBytes, [](const Node* n, int side) {
+				return side == 0 ? n->left.get() : n->right.get();
+			});
 		}
 
 
 	private:
 		struct Node;
+		typedef typename Policy::Stats Stats;
+		typedef typename Policy::Compare KeyCompare;
 
 		typedef std::shared_ptr<Node> NodePtr;
 		struct Node : public std::enable_shared_from_this<Node> {
@@ -441,41 +1272,19 @@ class AVL<K, void> {
 		NodePtr root_;
 
 		//compare the two trees
-		//loop through the trees and compare the keys
+		//walk both in order in lockstep, equal when every key matches by the comparator
+		//and both run out together
 		static bool Compare(const AVL& tree1, const AVL& tree2) {
-			if (tree1.Empty() && tree2.Empty()) return true;
-			if (tree1.Empty() || tree2.Empty()) return false;
-
-			std::stack<NodePtr> stack1;
-			std::stack<NodePtr> stack2;
-
-			NodePtr node1 = tree1.root_;
-			NodePtr node2 = tree2.root_;
-
-			while (node1 != nullptr || !stack1.empty()) {
-				while (node1 != nullptr) {
-					stack1.push(node1);
-					node1 = node1->left;
-				}
-
-				node1 = stack1.top();
-				stack1.pop();
-
-				while (node2 != nullptr) {
-					stack2.push(node2);
-					node2 = node2->left;
-				}
-
-				node2 = stack2.top();
-				stack2.pop();
-
-				if (node1->key != node2->key) return false;
-
-				node1 = node1->right;
-				node2 = node2->right;
+			Itr a(tree1.root_);
+			Itr b(tree2.root_);
+			for (;;) {
+				const Node *p = a.current();
+				const Node *q = b.current();
+				if (p == nullptr || q == nullptr) return p == q;
+				if (KeyCompare::Compare(p->key, q->key) != 0) return false;
+				a.MoveNext();
+				b.MoveNext();
 			}
-
-			return true;
 		}
 
 		//print
@@ -522,10 +1331,13 @@ class AVL<K, void> {
 
 				private:
 					size_t depth_{0};
-					Node *nodes_[32];
 					/*
-						max depth of 32 which is ~4 billion nodes :)
+						the iterator holds one node per level on the path from the root,
+						and no AVL tree with a 64 bit node count is taller than maxHeight(UINT64_MAX) = 90,
+						the 32 levels there used to be hold paths of trees up to height 31, which only
+						covers every tree of fewer than N(32) = 9,227,464 nodes
 					*/
+					Node *nodes_[maxHeight(UINT64_MAX) + 1];
 
 		};
 
@@ -560,6 +1372,11 @@ class AVL<K, void> {
 
 		explicit AVL(NodePtr root) : root_(std::move(root)) {}
 
+		AVL Updated(NodePtr root, bool* changed) const {
+			if (changed) *changed = root != root_;
+			return AVL(std::move(root));
+		}
+
 		template <class F>
 		static void ForEachImplementation(const Node *node, F&& f) {
 			if (!node) return;
@@ -572,16 +1389,26 @@ class AVL<K, void> {
 			return node ? node->height : 0;
 		}
 
+		static const size_t kNodeBytes = sizeof(Node) + 2 * sizeof(void*);
+
 		static NodePtr MakeNode(K key, const NodePtr& left, const NodePtr& right) {
+			Stats::OnAllocate(kNodeBytes);
 			return std::make_shared<Node>(std::move(key), left, right,
 				1 + std::max(Height(left), Height(right)));
 		}
 
-		static NodePtr Get(const NodePtr& node, const K& key) {
-			if (!node) return nullptr;
-			if (node->key < key) return Get(node->right, key);
-			if (key < node->key) return Get(node->left, key);
-			return node;
+		static const Node* Get(const NodePtr& node, const K& key) {
+			const Node* n = node.get();
+			int depth = 0;
+			while (n) {
+				depth++;
+				const int c = KeyCompare::Compare(n->key, key);
+				if (c < 0) n = n->right.get();
+				else if (c > 0) n = n->left.get();
+				else break;
+			}
+			Stats::OnLookup(depth);
+			return n;
 		}
 
 		static NodePtr RotateLeft(K key, const NodePtr& left, const NodePtr& right) {
@@ -594,42 +1421,54 @@ class AVL<K, void> {
 				MakeNode(std::move(key), left->right, right));
 		}
 
+		//left child is right heavy: rotate it left, then rotate this node right
 		static NodePtr RotateLR(K key, const NodePtr& left, const NodePtr& right) {
-			return RotateLeft(key, left, RotateRight(right->key, right->left, right->right));
+			return RotateRight(std::move(key), RotateLeft(left->key, left->left, left->right), right);
 		}
 
+		//right child is left heavy: rotate it right, then rotate this node left
 		static NodePtr RotateRL(K key, const NodePtr& left, const NodePtr& right) {
-			return RotateRight(key, RotateLeft(left->key, left->left, left->right), right);
+			return RotateLeft(std::move(key), left, RotateRight(right->key, right->left, right->right));
 		}
 
 		static NodePtr Rebalance(K key, const NodePtr& left, const NodePtr& right) {
 			switch (Height(left) - Height(right)) {
 				case 2:
 					if (Height(left->left) - Height(left->right) == -1) {
+						Stats::OnRotate(Rotation::LR);
 						return RotateLR(std::move(key), left, right);
 					} else {
+						Stats::OnRotate(Rotation::R);
 						return RotateRight(std::move(key), left, right);
 					}
 				case -2:
 					if (Height(right->left) - Height(right->right) == 1) {
+						Stats::OnRotate(Rotation::RL);
 						return RotateRL(std::move(key), left, right);
 					} else {
+						Stats::OnRotate(Rotation::L);
 						return RotateLeft(std::move(key), left, right);
 					}
 				default:
-					return MakeNode(key, left, right);
+					return MakeNode(std::move(key), left, right);
 			}
 		}
 
+		//unchanged subtrees come back as the same pointer, so their parents can be kept too
 		static NodePtr AddKey(const NodePtr& node, K key) {
 			if (!node) return MakeNode(std::move(key), nullptr, nullptr);
-			if (key < node->key) {
-				return Rebalance(node->key, AddKey(node->left, std::move(key)), node->right);
+			const int c = KeyCompare::Compare(node->key, key);
+			if (c > 0) {
+				NodePtr left = AddKey(node->left, std::move(key));
+				if (left == node->left) return node;
+				return Rebalance(node->key, std::move(left), node->right);
 			}
-			if (node->key < key) {
-				return Rebalance(node->key, node->left, AddKey(node->right, std::move(key)));
+			if (c < 0) {
+				NodePtr right = AddKey(node->right, std::move(key));
+				if (right == node->right) return node;
+				return Rebalance(node->key, node->left, std::move(right));
 			}
-			return MakeNode(std::move(key), node->left, node->right);
+			return node;
 		}
 
 		static NodePtr InOrderH(NodePtr node) {
@@ -645,11 +1484,16 @@ class AVL<K, void> {
 		static NodePtr RemoveKey(const NodePtr& node, const K& key) {
 			if (!node) return nullptr;
 
-			if (key < node->key) {
-				return Rebalance(node->key, RemoveKey(node->left, key), node->right);
+			const int c = KeyCompare::Compare(node->key, key);
+			if (c > 0) {
+				NodePtr left = RemoveKey(node->left, key);
+				if (left == node->left) return node;
+				return Rebalance(node->key, std::move(left), node->right);
 			}
-			if (node->key < key) {
-				return Rebalance(node->key, node->left, RemoveKey(node->right, key));
+			if (c < 0) {
+				NodePtr right = RemoveKey(node->right, key);
+				if (right == node->right) return node;
+				return Rebalance(node->key, node->left, std::move(right));
 			}
 
 			if (!node->left) return node->right;
@@ -663,7 +1507,6 @@ class AVL<K, void> {
 				return Rebalance(t->key, RemoveKey(node->left, t->key), node->right);
 			}
 		}
-		abort();
 	
 
 };
@@ -0,0 +1,952 @@
+/*
+	Benchmark of the trees in this directory against the standard library:
+	bst::BST and avl::AVL, each as a map and as a set (the void value form), and std::map / std::set.
+
+	For every workload and size n, each structure is built by n inserts, then answers n lookups,
+	scans all keys in order, and has every key removed again. One CSV line is printed per
+	structure, workload, size and operation with the time per operation, and the live heap
+	bytes per key of the built tree, counted by the operator new of this file (requested sizes,
+	the allocator's own overhead is not included).
+
+	workloads:
+	sorted  keys 0 .. n-1 inserted and removed in ascending order, lookups uniform
+	random  the same keys in a random order, lookups uniform
+	zipf    random insert order, lookups follow a Zipf distribution (s = --zipf) over the keys,
+	        so a few hot keys take most of them
+
+	The blob maps hold a string of --blob-bytes (1 KiB) per key, to show what path copying costs
+	with large values: avl::AVL with InlineValues copies the value of every node it rebuilds,
+	with SharedValues it only copies a handle.
+
+	avl_map_batch is avl_map with its lookups made all at once through FindBatch, which interleaves
+	them so their cache misses overlap; the other lines are the same as avl_map's. avl_map_shared
+	and avl_map_shared_batch are the same two with SharedValues, where a lookup misses twice a
+	level, on the node and on the pair behind its handle. The array FindBatch writes into is
+	allocated before the lookups are timed.
+
+	avl_set_hashcons is the HashConsedSet of hashConsedSet.h. Besides the usual lines, it and
+	avl_set get an equal line: the keys are added ascending to one set and descending to another,
+	and the time is that of == between the two, which walks both avl::AVL trees but only compares
+	the roots of the hash-consed ones. The line is only correct if == is true for those two,
+	false once a key is removed from one of them, and false between a set and itself without
+	its last key, in both directions.
+
+	avl_small and avl_map_small spread the keys over n / 10 maps of 10 keys each, key k in map
+	k % (n / 10), as SmallAVL of smallAvl.h and as avl::AVL, to show what the many small trees of
+	an application cost; bytes_per_key includes the handles of the maps themselves. avl_small also
+	gets a check line: random updates over 32 keys, growing each map past 16 entries and shrinking
+	it below 8 again, applied to a SmallAVL and an avl::AVL side by side, map and set form, inline
+	and shared values. The line is only correct if after every update both have the same entries
+	and changed flags, an update that changed nothing returned the same root, the SmallAVL is an
+	array or a tree as the thresholds say, and its == agrees with the entries against earlier
+	versions and against a copy built anew in the other form, and two maps in tree form that differ
+	only in their last key, or by one key at the end, are unequal. Its n is the number of updates.
+
+	avl_map_parallel times the parallel walks of avl::AVL on the map of keys 0 .. n-1 to themselves,
+	on a pool of --threads workers (one per core by default), and checks each against a sequential
+	walk: a reduce line for ParallelReduce, which must see the keys in order, a foreach line for
+	ParallelForEach, a filter line for Filter keeping the even keys, and a map_values line for
+	MapValues doubling every value. Its throw line has a ParallelForEach throw on one key, and is
+	only correct if the exception comes out of it and a reduce right after still gets the right answer.
+
+	interval_map is the IntervalMap of intervalMap.h, with n random intervals: starts uniform over
+	0 .. n-1 and lengths uniform over 1 .. 100. Its overlap and stab lines time Overlapping on
+	random windows of the same lengths and Stab on random points, and interval_scan times the same
+	overlap queries as a scan over all n intervals in a vector. Every answer of the map is checked
+	against the scan's, outside the timing; the scan is O(n) a query, so there are only
+	10^8 / n queries, at least 10 and at most n.
+
+	The string sets have key k as a string of --str-prefix (32) equal bytes followed by the digits
+	of k, so every comparison runs through the prefix before the keys differ. avl::AVL and bst::BST
+	compare them with the three-way ThreeWayCompare of compare.h, one pass over the bytes per level,
+	and avl_set_str_less runs avl::AVL with LessCompare, the operator< pair it used before.
+
+	usage: bench [--min-exp N] [--max-exp N] [--seed N] [--zipf s] [--bst-max N]
+	             [--blob-max N] [--blob-bytes N] [--str-max N] [--str-prefix N] [--interval-max N]
+	             [--threads N]
+	--min-exp/--max-exp  sizes 10^min .. 10^max, the default 3 .. 7
+	--blob-max           largest n the blob maps are run at, 10^5 by default, 100 MiB of values
+	--str-max            largest n the string sets are run at, 10^6 by default
+	--interval-max       largest n the interval lines are run at, 10^6 by default
+	--threads            workers of the parallel walks, 0 (the default) for one per core
+	--bst-max            largest n bst::BST is run at, 10^4 by default: its Add and Remove copy
+	                     the whole tree to return a new one, so building it is 0(n^2), and with
+	                     sorted keys it is a chain n nodes deep
+	bst::BST has no in order traversal besides printing, so it has no scan line.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <climits>
+#include <atomic>
+#include <stdexcept>
+
+#include "avl.h"
+#include "bst.h"
+#include "hashConsedSet.h"
+#include "intervalMap.h"
+#include "smallAvl.h"
+
+using namespace std;
+
+//live heap bytes, every allocation carries its size in a header in front of it
+//(the operators are kept out of line, inlined into the trees gcc takes the header for an overflow);
+//atomic, since the parallel walks allocate on the workers of their pool
+static atomic<size_t> liveBytes(0);
+
+static const size_t kHeader = alignof(max_align_t);
+
+__attribute__((noinline)) void* operator new(size_t size){
+	char* p = (char*)malloc(size + kHeader);
+	if(p == nullptr)
+		throw bad_alloc();
+	*(size_t*)p = size;
+	liveBytes.fetch_add(size, memory_order_relaxed);
+	return p + kHeader;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+	if(p == nullptr)
+		return;
+	char* base = (char*)p - kHeader;
+	liveBytes.fetch_sub(*(size_t*)base, memory_order_relaxed);
+	free(base);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	operator delete(p);
+}
+
+/*
+	every structure behind the same small interface, keys are ints and map values are the key,
+	Scan adds up the keys in order and returns false when the structure cannot traverse
+*/
+struct BstMap {
+	bst::BST<int, int> tree;
+	void Insert(int k){ tree = tree.Add(k, k); }
+	bool Lookup(int k) const {
+		try {
+			return tree.Find(k) == k;
+		} catch(const out_of_range&){
+			return false;
+		}
+	}
+	void Remove(int k){ tree = tree.Remove(k); }
+	bool Scan(long long&) const { return false; }
+};
+
+struct BstSet {
+	bst::BST<int, void> tree;
+	void Insert(int k){ tree = tree.Add(k); }
+	bool Lookup(int k) const { return tree.Contains(k); }
+	void Remove(int k){ tree = tree.Remove(k); }
+	bool Scan(long long&) const { return false; }
+};
+
+template <class ValuesPolicy>
+struct AvlValuesMap {
+	struct Policy : avl::DefaultPolicy {
+		typedef ValuesPolicy Values;
+	};
+	avl::AVL<int, int, Policy> tree;
+	void Insert(int k){ tree = tree.Add(k, k); }
+	bool Lookup(int k) const {
+		const int* v = tree.Find(k);
+		return v != nullptr && *v == k;
+	}
+	void Remove(int k){ tree = tree.Remove(k); }
+	bool Scan(long long& sum) const {
+		tree.ForEach([&](const int& k, const int&){ sum += k; });
+		return true;
+	}
+};
+
+typedef AvlValuesMap<avl::InlineValues> AvlMap;
+typedef AvlValuesMap<avl::SharedValues> AvlSharedMap;
+
+//a map with its lookups made through FindBatch, see LookupAll, into values, sized before the timing
+template <class Map>
+struct Batch : Map {
+	mutable vector<const int*> values;
+};
+
+struct AvlSet {
+	avl::AVL<int> tree;
+	void Insert(int k){ tree = tree.Add(k); }
+	bool Lookup(int k) const { return tree.Lookup(k); }
+	void Remove(int k){ tree = tree.Remove(k); }
+	bool Scan(long long& sum) const {
+		tree.ForEach([&](const int& k){ sum += k; });
+		return true;
+	}
+};
+
+struct AvlSetHashConsed {
+	avl::HashConsedSet<int> tree;
+	void Insert(int k){ tree = tree.Add(k); }
+	bool Lookup(int k) const { return tree.Lookup(k); }
+	void Remove(int k){ tree = tree.Remove(k); }
+	bool Scan(long long& sum) const {
+		tree.ForEach([&](const int& k){ sum += k; });
+		return true;
+	}
+};
+
+//number of maps of the small lines, set before each Run of them
+static size_t smallMaps = 1;
+
+//the keys spread over smallMaps maps, see the top of the file
+template <class Map>
+struct SmallMaps {
+	vector<Map> maps;
+	SmallMaps() : maps(smallMaps) {}
+	void Insert(int k){
+		Map& m = maps[k % maps.size()];
+		m = m.Add(k, k);
+	}
+	bool Lookup(int k) const {
+		const int* v = maps[k % maps.size()].Find(k);
+		return v != nullptr && *v == k;
+	}
+	void Remove(int k){
+		Map& m = maps[k % maps.size()];
+		m = m.Remove(k);
+	}
+	bool Scan(long long& sum) const {
+		for(const Map& m : maps){
+			m.ForEach([&](const int& k, const int&){ sum += k; });
+		}
+		return true;
+	}
+};
+
+struct StdMap {
+	map<int, int> tree;
+	void Insert(int k){ tree.emplace(k, k); }
+	bool Lookup(int k) const {
+		auto it = tree.find(k);
+		return it != tree.end() && it->second == k;
+	}
+	void Remove(int k){ tree.erase(k); }
+	bool Scan(long long& sum) const {
+		for(auto& kv : tree){
+			sum += kv.first;
+		}
+		return true;
+	}
+};
+
+struct StdSet {
+	set<int> tree;
+	void Insert(int k){ tree.insert(k); }
+	bool Lookup(int k) const { return tree.count(k) != 0; }
+	void Remove(int k){ tree.erase(k); }
+	bool Scan(long long& sum) const {
+		for(int k : tree){
+			sum += k;
+		}
+		return true;
+	}
+};
+
+//size of the values of the blob maps, set from --blob-bytes
+static size_t blobBytes = 1024;
+
+//the value stored for key k in the blob maps
+string Blob(int k){
+	return string(blobBytes, (char)('a' + k % 26));
+}
+
+bool IsBlob(const string* v, int k){
+	return v != nullptr && v->size() == blobBytes && (*v)[0] == 'a' + k % 26;
+}
+
+//avl::AVL map with large string values, stored the way ValuesPolicy says
+template <class ValuesPolicy>
+struct AvlBlobMap {
+	struct Policy : avl::DefaultPolicy {
+		typedef ValuesPolicy Values;
+	};
+	avl::AVL<int, string, Policy> tree;
+	void Insert(int k){ tree = tree.Add(k, Blob(k)); }
+	bool Lookup(int k) const { return IsBlob(tree.Find(k), k); }
+	void Remove(int k){ tree = tree.Remove(k); }
+	bool Scan(long long& sum) const {
+		tree.ForEach([&](const int& k, const string&){ sum += k; });
+		return true;
+	}
+};
+
+//the keys of the string sets, strKeys[k] is key k, built by MakeStrKeys before the runs
+static size_t strPrefix = 32;
+static vector<string> strKeys;
+
+void MakeStrKeys(int n){
+	strKeys.resize(n);
+	for(int k = 0; k < n; k++){
+		strKeys[k] = string(strPrefix, '/') + to_string(k);
+	}
+}
+
+//k back from its string, for the scans
+long long StrKey(const string& s){
+	return atoll(s.c_str() + strPrefix);
+}
+
+//avl::AVL set of strings, comparing them with KeyCompare
+template <class KeyCompare>
+struct AvlStrSet {
+	struct Policy : avl::DefaultPolicy {
+		typedef KeyCompare Compare;
+	};
+	avl::AVL<string, void, Policy> tree;
+	void Insert(int k){ tree = tree.Add(strKeys[k]); }
+	bool Lookup(int k) const { return tree.Lookup(strKeys[k]); }
+	void Remove(int k){ tree = tree.Remove(strKeys[k]); }
+	bool Scan(long long& sum) const {
+		tree.ForEach([&](const string& k){ sum += StrKey(k); });
+		return true;
+	}
+};
+
+struct BstStrSet {
+	bst::BST<string, void> tree;
+	void Insert(int k){ tree = tree.Add(strKeys[k]); }
+	bool Lookup(int k) const { return tree.Contains(strKeys[k]); }
+	void Remove(int k){ tree = tree.Remove(strKeys[k]); }
+	bool Scan(long long&) const { return false; }
+};
+
+struct StdStrSet {
+	set<string> tree;
+	void Insert(int k){ tree.insert(strKeys[k]); }
+	bool Lookup(int k) const { return tree.count(strKeys[k]) != 0; }
+	void Remove(int k){ tree.erase(strKeys[k]); }
+	bool Scan(long long& sum) const {
+		for(const string& k : tree){
+			sum += StrKey(k);
+		}
+		return true;
+	}
+};
+
+struct StdBlobMap {
+	map<int, string> tree;
+	void Insert(int k){ tree.emplace(k, Blob(k)); }
+	bool Lookup(int k) const {
+		auto it = tree.find(k);
+		return it != tree.end() && IsBlob(&it->second, k);
+	}
+	void Remove(int k){ tree.erase(k); }
+	bool Scan(long long& sum) const {
+		for(auto& kv : tree){
+			sum += kv.first;
+		}
+		return true;
+	}
+};
+
+enum Workload { Sorted, Random, Zipf };
+
+const char* WorkloadName(Workload w){
+	switch(w){
+		case Sorted: return "sorted";
+		case Random: return "random";
+		case Zipf: return "zipf";
+	}
+	return "?";
+}
+
+//the keys in insert order, the keys in remove order, and the lookups, all over 0 .. n-1
+struct Keys {
+	vector<int> inserts;
+	vector<int> removes;
+	vector<int> lookups;
+};
+
+Keys MakeKeys(Workload w, int n, double zipf, mt19937_64& rng){
+	Keys keys;
+	keys.inserts.resize(n);
+	for(int i = 0; i < n; i++){
+		keys.inserts[i] = i;
+	}
+	if(w != Sorted)
+		shuffle(keys.inserts.begin(), keys.inserts.end(), rng);
+	keys.removes = keys.inserts;
+
+	keys.lookups.resize(n);
+	if(w != Zipf){
+		uniform_int_distribution<int> key(0, n - 1);
+		for(int i = 0; i < n; i++){
+			keys.lookups[i] = key(rng);
+		}
+		return keys;
+	}
+
+	//rank r is drawn with weight 1 / r^s by inverting the cumulative weights,
+	//and rank r is key inserts[r], so the hot keys are spread over the tree
+	vector<double> cumulative(n);
+	double total = 0;
+	for(int r = 0; r < n; r++){
+		total += 1.0 / pow(r + 1, zipf);
+		cumulative[r] = total;
+	}
+	uniform_real_distribution<double> u(0, total);
+	for(int i = 0; i < n; i++){
+		int r = lower_bound(cumulative.begin(), cumulative.end(), u(rng)) - cumulative.begin();
+		keys.lookups[i] = keys.inserts[min(r, n - 1)];
+	}
+	return keys;
+}
+
+struct Options {
+	int minExp = 3;
+	int maxExp = 7;
+	unsigned long long seed = 42;
+	double zipf = 0.99;
+	long long bstMax = 10000;
+	long long blobMax = 100000;
+	long long strMax = 1000000;
+	long long intervalMax = 1000000;
+	unsigned threads = 0;
+};
+
+Options ParseOptions(int argc, char* argv[]){
+	Options o;
+	for(int i = 1; i < argc; i++){
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if(arg == "--min-exp" && hasValue)
+			o.minExp = atoi(argv[++i]);
+		else if(arg == "--max-exp" && hasValue)
+			o.maxExp = atoi(argv[++i]);
+		else if(arg == "--seed" && hasValue)
+			o.seed = strtoull(argv[++i], NULL, 10);
+		else if(arg == "--zipf" && hasValue)
+			o.zipf = atof(argv[++i]);
+		else if(arg == "--bst-max" && hasValue)
+			o.bstMax = atoll(argv[++i]);
+		else if(arg == "--blob-max" && hasValue)
+			o.blobMax = atoll(argv[++i]);
+		else if(arg == "--blob-bytes" && hasValue)
+			blobBytes = max(1, atoi(argv[++i]));
+		else if(arg == "--str-max" && hasValue)
+			o.strMax = atoll(argv[++i]);
+		else if(arg == "--str-prefix" && hasValue)
+			strPrefix = max(0, atoi(argv[++i]));
+		else if(arg == "--interval-max" && hasValue)
+			o.intervalMax = atoll(argv[++i]);
+		else if(arg == "--threads" && hasValue)
+			o.threads = (unsigned)max(0, atoi(argv[++i]));
+		else
+			throw invalid_argument("unknown option " + arg);
+	}
+	o.minExp = max(o.minExp, 0);
+	o.maxExp = min(o.maxExp, 8);
+	return o;
+}
+
+void Emit(const Options& o, const char* structure, Workload w, int n, const char* operation,
+	size_t ops, double ns, double bytesPerKey, bool correct)
+{
+	cout << structure << "," << WorkloadName(w) << "," << n << "," << operation << "," << ops << ","
+		<< ns / ops << "," << bytesPerKey << "," << o.seed << "," << (correct ? 1 : 0) << endl;
+}
+
+template <class F>
+double TimeNs(F&& f){
+	auto start = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+}
+
+//the lookups of Run, one at a time unless the structure batches them
+template <class Tree>
+size_t LookupAll(const Tree& tree, const vector<int>& keys){
+	size_t found = 0;
+	for(int k : keys){
+		found += tree.Lookup(k);
+	}
+	return found;
+}
+
+template <class Map>
+size_t LookupAll(const Batch<Map>& tree, const vector<int>& keys){
+	vector<const int*>& values = tree.values;
+	tree.tree.FindBatch(keys.data(), keys.size(), values.data());
+	size_t found = 0;
+	for(size_t i = 0; i < keys.size(); i++){
+		found += values[i] != nullptr && *values[i] == keys[i];
+	}
+	return found;
+}
+
+//what LookupAll needs allocated, done before it is timed
+template <class Tree>
+void PrepareLookups(Tree&, const vector<int>&){}
+
+template <class Map>
+void PrepareLookups(Batch<Map>& tree, const vector<int>& keys){
+	tree.values.assign(keys.size(), nullptr);
+}
+
+//build, look up, scan and empty one structure, and print a line for each; false if any answer was wrong
+template <class Tree>
+bool Run(const Options& o, const char* name, Workload w, const Keys& keys){
+	const int n = (int)keys.inserts.size();
+	bool allCorrect = true;
+
+	size_t before = liveBytes;
+	Tree* tree = new Tree();
+	double ns = TimeNs([&]{
+		for(int k : keys.inserts){
+			tree->Insert(k);
+		}
+	});
+	const double bytesPerKey = (double)(liveBytes - before) / n;
+	Emit(o, name, w, n, "insert", n, ns, bytesPerKey, true);
+
+	PrepareLookups(*tree, keys.lookups);
+	size_t found = 0;
+	ns = TimeNs([&]{ found = LookupAll(*tree, keys.lookups); });
+	bool correct = found == keys.lookups.size();
+	allCorrect &= correct;
+	Emit(o, name, w, n, "lookup", keys.lookups.size(), ns, bytesPerKey, correct);
+
+	long long sum = 0;
+	bool scanned = false;
+	ns = TimeNs([&]{ scanned = tree->Scan(sum); });
+	if(scanned){
+		correct = sum == (long long)n * (n - 1) / 2;
+		allCorrect &= correct;
+		Emit(o, name, w, n, "scan", n, ns, bytesPerKey, correct);
+	}
+
+	ns = TimeNs([&]{
+		for(int k : keys.removes){
+			tree->Remove(k);
+		}
+	});
+	delete tree;
+	correct = liveBytes == before;
+	allCorrect &= correct;
+	Emit(o, name, w, n, "remove", n, ns, bytesPerKey, correct);
+	return allCorrect;
+}
+
+//the equal line of a set, see the top of the file
+template <class Set>
+bool RunEqual(const Options& o, const char* name, int n){
+	Set up, down;
+	for(int k = 0; k < n; k++){
+		up.Insert(k);
+		down.Insert(n - 1 - k);
+	}
+	const size_t reps = max<size_t>(1, 10000000 / n);
+	size_t equal = 0;
+	const double ns = TimeNs([&]{
+		for(size_t i = 0; i < reps; i++){
+			equal += up.tree == down.tree;
+		}
+	});
+	//up without its last key is a proper prefix of it, unequal from either side
+	Set prefix = up;
+	prefix.Remove(n - 1);
+	down.Remove(n / 2);
+	const bool correct = equal == reps && !(up.tree == down.tree)
+		&& !(up.tree == prefix.tree) && !(prefix.tree == up.tree);
+	Emit(o, name, Sorted, n, "equal", reps, ns, 0, correct);
+	return correct;
+}
+
+//the keys of a ParallelReduce in a row: their sum, the first and last, and whether they were in order
+struct Span {
+	long long sum;
+	int first;
+	int last;
+	bool ordered;
+	bool empty;
+};
+
+Span Combine(const Span& a, const Span& b){
+	if(a.empty)
+		return b;
+	if(b.empty)
+		return a;
+	return Span{ a.sum + b.sum, a.first, b.last, a.ordered && b.ordered && a.last < b.first, false };
+}
+
+//the entries of a map or a set in order, the value of a set's keys 0
+template <class Tree>
+vector<pair<int, int> > EntriesOf(const Tree& tree, false_type){
+	vector<pair<int, int> > entries;
+	tree.ForEach([&](const int& k, const int& v){ entries.emplace_back(k, v); });
+	return entries;
+}
+
+template <class Tree>
+vector<pair<int, int> > EntriesOf(const Tree& tree, true_type){
+	vector<pair<int, int> > entries;
+	tree.ForEach([&](const int& k){ entries.emplace_back(k, 0); });
+	return entries;
+}
+
+//update both forms alike, with v ignored by sets
+template <class Tree>
+Tree AddTo(const Tree& tree, int k, int v, bool* changed, false_type){
+	return tree.Add(k, v, changed);
+}
+
+template <class Tree>
+Tree AddTo(const Tree& tree, int k, int, bool* changed, true_type){
+	return tree.Add(k, changed);
+}
+
+template <class ValuesPolicy>
+struct SmallPolicy : avl::DefaultPolicy {
+	typedef ValuesPolicy Values;
+};
+
+//one run of the small check, see the top of the file; V is void for the set form
+template <class V, class ValuesPolicy>
+bool CheckSmall(mt19937_64& rng, size_t& updates){
+	typedef avl::SmallAVL<int, V, SmallPolicy<ValuesPolicy> > Small;
+	typedef avl::AVL<int, V, SmallPolicy<ValuesPolicy> > Tree;
+	typedef is_void<V> IsSet;
+
+	Small small;
+	Tree tree;
+	vector<Small> versions;
+	bool grow = true;
+	bool wasTree = false;
+	uniform_int_distribution<int> key(0, 31), value(0, 2);
+	for(int step = 0; step < 2000; step++){
+		const int k = key(rng);
+		bool smallChanged = false, treeChanged = false;
+		Small next;
+		if(grow){
+			const int v = value(rng);
+			next = AddTo(small, k, v, &smallChanged, IsSet());
+			tree = AddTo(tree, k, v, &treeChanged, IsSet());
+		} else {
+			next = small.Remove(k, &smallChanged);
+			tree = tree.Remove(k, &treeChanged);
+		}
+		updates++;
+		if(smallChanged != treeChanged || (!smallChanged && !next.SameRoot(small)))
+			return false;
+		small = next;
+
+		const vector<pair<int, int> > entries = EntriesOf(tree, IsSet());
+		if(EntriesOf(small, IsSet()) != entries || small.Size() != entries.size())
+			return false;
+		const bool isTree = small.Size() >= avl::kSmallSize || (wasTree && small.Size() >= avl::kSmallSize / 2);
+		if(small.IsTree() != isTree)
+			return false;
+		wasTree = isTree;
+
+		//the same entries added anew, an array below kSmallSize whatever form small is in
+		Small copy;
+		for(const pair<int, int>& e : entries){
+			copy = AddTo(copy, e.first, e.second, nullptr, IsSet());
+		}
+		if(!(copy == small) || !(small == copy))
+			return false;
+		for(size_t i = versions.size() > 8 ? versions.size() - 8 : 0; i < versions.size(); i++){
+			if((versions[i] == small) != (EntriesOf(versions[i], IsSet()) == entries))
+				return false;
+		}
+		versions.push_back(small);
+
+		if(grow && small.Size() >= 20)
+			grow = false;
+		else if(!grow && small.Size() <= 4)
+			grow = true;
+	}
+
+	//promoted trees that differ only in their last key, or by one key at the end
+	Small first, last, shorter, longer;
+	for(int k = 0; k < 19; k++){
+		first = AddTo(first, k, 0, nullptr, IsSet());
+	}
+	shorter = first;
+	last = AddTo(first, 20, 0, nullptr, IsSet());
+	first = AddTo(first, 19, 0, nullptr, IsSet());
+	longer = AddTo(first, 20, 0, nullptr, IsSet());
+	if(!first.IsTree() || !last.IsTree() || !shorter.IsTree() || !longer.IsTree())
+		return false;
+	const Small* pairs[][2] = { { &first, &last }, { &first, &shorter }, { &first, &longer } };
+	for(const auto& p : pairs){
+		if(*p[0] == *p[1] || *p[1] == *p[0])
+			return false;
+	}
+	return true;
+}
+
+//the parallel lines, see the top of the file
+bool RunParallel(const Options& o, WorkPool& pool, int n){
+	typedef avl::AVL<int, int> Tree;
+	const long long total = (long long)n * (n - 1) / 2;
+	//small enough that the walks fork from n = 10^3 up
+	const size_t grain = 64;
+	bool allCorrect = true;
+
+	size_t before = liveBytes;
+	{
+		Tree tree;
+		for(int k = 0; k < n; k++){
+			tree = tree.Add(k, k);
+		}
+
+		Span span{};
+		double ns = TimeNs([&]{
+			span = tree.ParallelReduce(Span{ 0, 0, 0, true, true },
+				[](const int& k, const int&){ return Span{ k, k, k, true, false }; },
+				Combine, grain, pool);
+		});
+		bool correct = !span.empty && span.sum == total && span.first == 0 && span.last == n - 1 && span.ordered;
+		allCorrect &= correct;
+		Emit(o, "avl_map_parallel", Sorted, n, "reduce", n, ns, 0, correct);
+
+		atomic<long long> sum(0);
+		atomic<int> calls(0);
+		ns = TimeNs([&]{
+			tree.ParallelForEach([&](const int& k, const int& v){
+				sum.fetch_add(k + v, memory_order_relaxed);
+				calls.fetch_add(1, memory_order_relaxed);
+			}, grain, pool);
+		});
+		correct = sum == 2 * total && calls == n;
+		allCorrect &= correct;
+		Emit(o, "avl_map_parallel", Sorted, n, "foreach", n, ns, 0, correct);
+
+		Tree even;
+		ns = TimeNs([&]{
+			even = tree.Filter([](const int& k, const int&){ return k % 2 == 0; }, grain, pool);
+		});
+		int next = 0;
+		correct = true;
+		even.ForEach([&](const int& k, const int& v){
+			correct &= k == next && v == k;
+			next += 2;
+		});
+		correct &= next == n + n % 2;
+		allCorrect &= correct;
+		Emit(o, "avl_map_parallel", Sorted, n, "filter", n, ns, 0, correct);
+
+		avl::AVL<int, long long> doubled;
+		ns = TimeNs([&]{
+			doubled = tree.MapValues([](const int&, const int& v){ return 2LL * v; }, grain, pool);
+		});
+		next = 0;
+		correct = true;
+		doubled.ForEach([&](const int& k, const long long& v){
+			correct &= k == next && v == 2LL * k;
+			next++;
+		});
+		correct &= next == n;
+		allCorrect &= correct;
+		Emit(o, "avl_map_parallel", Sorted, n, "map_values", n, ns, 0, correct);
+
+		bool threw = false;
+		ns = TimeNs([&]{
+			try {
+				tree.ParallelForEach([&](const int& k, const int&){
+					if(k == n / 2)
+						throw runtime_error("thrown by the walk");
+				}, grain, pool);
+			} catch(const runtime_error&){
+				threw = true;
+			}
+		});
+		span = tree.ParallelReduce(Span{ 0, 0, 0, true, true },
+			[](const int& k, const int&){ return Span{ k, k, k, true, false }; },
+			Combine, grain, pool);
+		correct = threw && span.sum == total && span.ordered;
+		allCorrect &= correct;
+		Emit(o, "avl_map_parallel", Sorted, n, "throw", n, ns, 0, correct);
+	}
+	const bool correct = liveBytes == before;
+	if(!correct)
+		Emit(o, "avl_map_parallel", Sorted, n, "free", n, 0, 0, correct);
+	return allCorrect && correct;
+}
+
+//the interval lines, see the top of the file
+bool RunInterval(const Options& o, int n, mt19937_64& rng){
+	typedef avl::IntervalMap<int, int> Map;
+	uniform_int_distribution<int> start(0, n - 1), length(1, 100);
+	vector<avl::Interval<int> > intervals(n);
+	for(int i = 0; i < n; i++){
+		intervals[i].start = start(rng);
+		intervals[i].end = intervals[i].start + length(rng);
+	}
+	const size_t queries = max<size_t>(10, min<size_t>(n, 100000000 / n));
+	vector<avl::Interval<int> > windows(queries);
+	for(size_t q = 0; q < queries; q++){
+		windows[q].start = start(rng);
+		windows[q].end = windows[q].start + length(rng);
+	}
+
+	//a later duplicate of an interval replaces the value of the earlier one in the map
+	vector<char> replaced(n, 0);
+	{
+		map<pair<int, int>, int> last;
+		for(int i = 0; i < n; i++){
+			auto it = last.find(make_pair(intervals[i].start, intervals[i].end));
+			if(it != last.end())
+				replaced[it->second] = 1;
+			last[make_pair(intervals[i].start, intervals[i].end)] = i;
+		}
+	}
+	//the sum of the values of the intervals each query reports
+	vector<long long> mapSums(queries, 0), scanSums(queries, 0);
+
+	size_t before = liveBytes;
+	Map* tree = new Map();
+	double ns = TimeNs([&]{
+		for(int i = 0; i < n; i++){
+			*tree = tree->Add(intervals[i].start, intervals[i].end, i);
+		}
+	});
+	const double bytesPerKey = (double)(liveBytes - before) / n;
+	Emit(o, "interval_map", Random, n, "insert", n, ns, bytesPerKey, true);
+
+	ns = TimeNs([&]{
+		for(size_t q = 0; q < queries; q++){
+			tree->Overlapping(windows[q].start, windows[q].end,
+				[&](const avl::Interval<int>&, const int& v){ mapSums[q] += v; });
+		}
+	});
+	double scanNs = TimeNs([&]{
+		for(size_t q = 0; q < queries; q++){
+			for(int i = 0; i < n; i++){
+				if(intervals[i].start < windows[q].end && windows[q].start < intervals[i].end && !replaced[i])
+					scanSums[q] += i;
+			}
+		}
+	});
+	bool correct = mapSums == scanSums;
+	bool allCorrect = correct;
+	Emit(o, "interval_map", Random, n, "overlap", queries, ns, bytesPerKey, correct);
+	Emit(o, "interval_scan", Random, n, "overlap", queries, scanNs, 0, correct);
+
+	fill(mapSums.begin(), mapSums.end(), 0);
+	ns = TimeNs([&]{
+		for(size_t q = 0; q < queries; q++){
+			tree->Stab(windows[q].start, [&](const avl::Interval<int>&, const int& v){ mapSums[q] += v; });
+		}
+	});
+	correct = true;
+	for(size_t q = 0; q < queries && correct; q++){
+		long long sum = 0;
+		for(int i = 0; i < n; i++){
+			if(intervals[i].start <= windows[q].start && windows[q].start < intervals[i].end && !replaced[i])
+				sum += i;
+		}
+		correct = sum == mapSums[q];
+	}
+	allCorrect &= correct;
+	Emit(o, "interval_map", Random, n, "stab", queries, ns, bytesPerKey, correct);
+
+	ns = TimeNs([&]{
+		for(int i = 0; i < n; i++){
+			*tree = tree->Remove(intervals[i].start, intervals[i].end);
+		}
+	});
+	correct = tree->Empty();
+	delete tree;
+	correct &= liveBytes == before;
+	allCorrect &= correct;
+	Emit(o, "interval_map", Random, n, "remove", n, ns, bytesPerKey, correct);
+	return allCorrect;
+}
+
+int main(int argc, char* argv[]){
+	Options o;
+	try {
+		o = ParseOptions(argc, argv);
+	} catch(const exception& e){
+		cerr << e.what() << endl;
+		return 2;
+	}
+
+	cout << "structure,workload,n,operation,ops,ns_per_op,bytes_per_key,seed,correct" << endl;
+
+	bool allCorrect = true;
+	WorkPool pool(o.threads);
+	const Workload workloads[] = { Sorted, Random, Zipf };
+	for(int e = o.minExp; e <= o.maxExp; e++){
+		const int n = (int)llround(pow(10, e));
+		if(n <= o.strMax)
+			MakeStrKeys(n);
+		allCorrect &= RunEqual<AvlSet>(o, "avl_set", n);
+		allCorrect &= RunEqual<AvlSetHashConsed>(o, "avl_set_hashcons", n);
+		allCorrect &= RunParallel(o, pool, n);
+		if(e == o.minExp){
+			mt19937_64 rng(o.seed);
+			size_t updates = 0;
+			bool correct = true;
+			const double ns = TimeNs([&]{
+				for(int r = 0; r < 10; r++){
+					correct &= CheckSmall<int, avl::InlineValues>(rng, updates);
+					correct &= CheckSmall<int, avl::SharedValues>(rng, updates);
+					correct &= CheckSmall<void, avl::InlineValues>(rng, updates);
+				}
+			});
+			allCorrect &= correct;
+			Emit(o, "avl_small", Random, (int)updates, "check", updates, ns, 0, correct);
+		}
+		if(n <= o.intervalMax){
+			mt19937_64 rng(o.seed + e);
+			allCorrect &= RunInterval(o, n, rng);
+		}
+		for(Workload w : workloads){
+			mt19937_64 rng(o.seed + e * 3 + w);
+			const Keys keys = MakeKeys(w, n, o.zipf, rng);
+
+			if(n <= o.bstMax){
+				allCorrect &= Run<BstMap>(o, "bst_map", w, keys);
+				allCorrect &= Run<BstSet>(o, "bst_set", w, keys);
+			}
+			allCorrect &= Run<AvlMap>(o, "avl_map", w, keys);
+			allCorrect &= Run<Batch<AvlMap> >(o, "avl_map_batch", w, keys);
+			allCorrect &= Run<AvlSharedMap>(o, "avl_map_shared", w, keys);
+			allCorrect &= Run<Batch<AvlSharedMap> >(o, "avl_map_shared_batch", w, keys);
+			allCorrect &= Run<AvlSet>(o, "avl_set", w, keys);
+			allCorrect &= Run<AvlSetHashConsed>(o, "avl_set_hashcons", w, keys);
+			smallMaps = max(1, n / 10);
+			allCorrect &= Run<SmallMaps<avl::SmallAVL<int, int> > >(o, "avl_small", w, keys);
+			allCorrect &= Run<SmallMaps<avl::AVL<int, int> > >(o, "avl_map_small", w, keys);
+			allCorrect &= Run<StdMap>(o, "std_map", w, keys);
+			allCorrect &= Run<StdSet>(o, "std_set", w, keys);
+			if(n <= o.blobMax){
+				allCorrect &= Run<AvlBlobMap<avl::InlineValues> >(o, "avl_map_blob_inline", w, keys);
+				allCorrect &= Run<AvlBlobMap<avl::SharedValues> >(o, "avl_map_blob_shared", w, keys);
+				allCorrect &= Run<StdBlobMap>(o, "std_map_blob", w, keys);
+			}
+			if(n <= o.strMax){
+				if(n <= o.bstMax)
+					allCorrect &= Run<BstStrSet>(o, "bst_set_str", w, keys);
+				allCorrect &= Run<AvlStrSet<ThreeWayCompare> >(o, "avl_set_str", w, keys);
+				allCorrect &= Run<AvlStrSet<LessCompare> >(o, "avl_set_str_less", w, keys);
+				allCorrect &= Run<StdStrSet>(o, "std_set_str", w, keys);
+			}
+		}
+	}
+
+	if(!allCorrect)
+		cerr << "some answers were wrong, see the correct column" << endl;
+	return allCorrect ? 0 : 1;
+}
@@ -4,9 +4,15 @@
 //implement simple binary search tree class, for the sake of converting it to an AVL tree
 //this is a simple binary search tree, with no balancing
 
+#include <iostream>
+#include <stdexcept>
+
+#include "compare.h"
+
 namespace bst
 {
-    template <typename K, typename V>
+    //KeyCompare is a three-way comparator, see compare.h
+    template <typename K, typename V, typename KeyCompare = ThreeWayCompare>
     class BST
     {
     public:
@@ -94,25 +100,37 @@ namespace bst
             return new Node(node->key, node->value, Copy(node->left), Copy(node->right));
         }
 
+        //Add and Remove work on the private copy made by the public Add and Remove,
+        //so they change it in place, building new nodes here would leak the copied ones
         Node* Add(Node* node, const K& key, const V& value) const
         {
             if (node == nullptr)
                 return new Node(key, value, nullptr, nullptr);
-            if (key < node->key)
-                return new Node(node->key, node->value, Add(node->left, key, value), node->right);
-            if (key > node->key)
-                return new Node(node->key, node->value, node->left, Add(node->right, key, value));
-            return new Node(key, value, node->left, node->right);
+            const int c = KeyCompare::Compare(node->key, key);
+            if (c > 0)
+                node->left = Add(node->left, key, value);
+            else if (c < 0)
+                node->right = Add(node->right, key, value);
+            else
+                node->value = value;
+            return node;
         }
 
         Node* Remove(Node* node, const K& key) const
         {
             if (node == nullptr)
                 return nullptr;
-            if (key < node->key)
-                return new Node(node->key, node->value, Remove(node->left, key), node->right);
-            if (key > node->key)
-                return new Node(node->key, node->value, node->left, Remove(node->right, key));
+            const int c = KeyCompare::Compare(node->key, key);
+            if (c > 0)
+            {
+                node->left = Remove(node->left, key);
+                return node;
+            }
+            if (c < 0)
+            {
+                node->right = Remove(node->right, key);
+                return node;
+            }
             if (node->left == nullptr)
             {
                 Node* right = node->right;
@@ -126,16 +144,20 @@ namespace bst
                 return left;
             }
             Node* min = FindMin(node->right);
-            return new Node(min->key, min->value, node->left, Remove(node->right, min->key));
+            node->key = min->key;
+            node->value = min->value;
+            node->right = Remove(node->right, min->key);
+            return node;
         }
 
         Node* Find(Node* node, const K& key) const
         {
             if (node == nullptr)
                 return nullptr;
-            if (key < node->key)
+            const int c = KeyCompare::Compare(node->key, key);
+            if (c > 0)
                 return Find(node->left, key);
-            if (key > node->key)
+            if (c < 0)
                 return Find(node->right, key);
             return node;
         }
@@ -180,8 +202,8 @@ namespace bst
     };
 
     //bst template with only key
-    template <typename K>
-    class BST<K, void>
+    template <typename K, typename KeyCompare>
+    class BST<K, void, KeyCompare>
     {
     public:
         BST() : root(nullptr) {}
@@ -273,25 +295,34 @@ namespace bst
             return new Node(node->key, Copy(node->left), Copy(node->right));
         }
 
+        //in place on the private copy, like the map form
         Node* Add(Node* node, const K& key) const
         {
             if (node == nullptr)
                 return new Node(key, nullptr, nullptr);
-            if (key < node->key)
-                return new Node(node->key, Add(node->left, key), node->right);
-            if (key > node->key)
-                return new Node(node->key, node->left, Add(node->right, key));
-            return new Node(key, node->left, node->right);
+            const int c = KeyCompare::Compare(node->key, key);
+            if (c > 0)
+                node->left = Add(node->left, key);
+            else if (c < 0)
+                node->right = Add(node->right, key);
+            return node;
         }
 
         Node* Remove(Node* node, const K& key) const
         {
             if (node == nullptr)
                 return nullptr;
-            if (key < node->key)
-                return new Node(node->key, Remove(node->left, key), node->right);
-            if (key > node->key)
-                return new Node(node->key, node->left, Remove(node->right, key));
+            const int c = KeyCompare::Compare(node->key, key);
+            if (c > 0)
+            {
+                node->left = Remove(node->left, key);
+                return node;
+            }
+            if (c < 0)
+            {
+                node->right = Remove(node->right, key);
+                return node;
+            }
             if (node->left == nullptr)
             {
                 Node* right = node->right;
@@ -305,16 +336,19 @@ namespace bst
                 return left;
             }
             Node* min = FindMin(node->right);
-            return new Node(min->key, node->left, Remove(node->right, min->key));
+            node->key = min->key;
+            node->right = Remove(node->right, min->key);
+            return node;
         }
 
         Node* Find(Node* node, const K& key) const
         {
             if (node == nullptr)
                 return nullptr;
-            if (key < node->key)
+            const int c = KeyCompare::Compare(node->key, key);
+            if (c > 0)
                 return Find(node->left, key);
-            if (key > node->key)
+            if (c < 0)
                 return Find(node->right, key);
             return node;
         }
@@ -0,0 +1,40 @@
+#ifndef COMPARE_H
+#define COMPARE_H
+
+/*
+	Three-way comparators for the trees in this directory: Compare(a, b) returns a negative
+	number when a < b, zero when they are equal and a positive number when a > b, so a search
+	makes one comparison per level instead of a < b and then b < a.
+
+	ThreeWayCompare uses a.compare(b) when the key has one (std::string, std::string_view),
+	which is a single pass over the characters, and falls back to operator< otherwise.
+	LessCompare always uses operator<, two comparisons when the keys are not below each other,
+	which is what the trees did before; it is kept for keys whose compare() means something else.
+*/
+
+struct LessCompare {
+	template <class A, class B>
+	static int Compare(const A& a, const B& b) {
+		return a < b ? -1 : (b < a ? 1 : 0);
+	}
+};
+
+struct ThreeWayCompare {
+	template <class A, class B>
+	static int Compare(const A& a, const B& b) {
+		return Dispatch(a, b, 0);
+	}
+
+private:
+	template <class A, class B>
+	static auto Dispatch(const A& a, const B& b, int) -> decltype(int(a.compare(b))) {
+		return a.compare(b);
+	}
+
+	template <class A, class B>
+	static int Dispatch(const A& a, const B& b, long) {
+		return LessCompare::Compare(a, b);
+	}
+};
+
+#endif
@@ -0,0 +1,275 @@
+#ifndef HASH_CONSED_SET_H
+#define HASH_CONSED_SET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+
+#include "avl.h"
+
+namespace avl {
+
+	/*
+		Persistent set whose equal versions are one tree, so == is a pointer comparison.
+
+		The shape of an avl::AVL depends on the order of its updates, so two equal sets built
+		differently share nothing and interning their nodes cannot make them one tree. This set
+		is a treap instead, a search tree by key that is also a heap by a priority, and the
+		priority of a key is a hash of it: for a given set of keys there is exactly one such tree,
+		whatever the order of the updates. Every node is interned: a node with an equal key and
+		the same two children as a live node is that node. By induction from the leaves, equal sets
+		are one root, and equal subsets of different sets, e.g. versions a few updates apart, are
+		one subtree, so their memory is shared.
+
+		Add and Remove path copy like avl::AVL's, returning the same set when they change nothing.
+		The depth is O(log n) in expectation over the hash, not in the worst case like an AVL tree,
+		and each node made costs a probe and an insert into the intern table.
+		Keys need std::hash and the comparator of Policy::Compare.
+
+		The intern table is shared by all threads, split into kShards locked shards by node hash,
+		so sets built on different threads share nodes too. It holds weak references: a node is
+		freed as soon as its last set lets go of it, and its deleter takes its entry out of the
+		table then, so the table only ever holds live nodes.
+	*/
+	template <class K, class Policy = DefaultPolicy>
+	class HashConsedSet {
+		public:
+			HashConsedSet() {}
+
+			HashConsedSet Add(const K &key, bool *changed = nullptr) const {
+				const bool add = !Lookup(key);
+				if (changed) *changed = add;
+				return add ? HashConsedSet(Insert(root_, key, Priority(key))) : *this;
+			}
+
+			HashConsedSet Remove(const K &key, bool *changed = nullptr) const {
+				const bool remove = Lookup(key);
+				if (changed) *changed = remove;
+				return remove ? HashConsedSet(Erase(root_, key)) : *this;
+			}
+
+			bool Lookup(const K &key) const {
+				const Node *n = root_.get();
+				while (n) {
+					const int c = KeyCompare::Compare(n->key, key);
+					if (c == 0) return true;
+					n = c < 0 ? n->right.get() : n->left.get();
+				}
+				return false;
+			}
+
+			template <class F>
+			void ForEach(F &&f) const {
+				ForEachImplementation(root_.get(), f);
+			}
+
+			bool Empty() const { return root_ == nullptr; }
+			size_t Size() const { return root_ ? root_->size : 0; }
+
+			bool SameRoot(const HashConsedSet &other) const { return root_ == other.root_; }
+
+			//equal sets are one tree, so this is exact and O(1)
+			friend bool operator==(const HashConsedSet &a, const HashConsedSet &b) {
+				return a.root_ == b.root_;
+			}
+
+			friend bool operator!=(const HashConsedSet &a, const HashConsedSet &b) {
+				return a.root_ != b.root_;
+			}
+
+			//nodes alive across all the sets of this type, for tests and measurements
+			static size_t LiveNodes() {
+				size_t count = 0;
+				for (Shard &shard : Interned().shards) {
+					std::lock_guard<std::mutex> g(shard.lock);
+					count += shard.nodes.size();
+				}
+				return count;
+			}
+
+		private:
+			typedef typename Policy::Compare KeyCompare;
+			struct Node;
+			typedef std::shared_ptr<const Node> NodePtr;
+
+			struct Node {
+				Node(const K &k, NodePtr l, NodePtr r, uint64_t p, size_t h)
+					: key(k), left(std::move(l)), right(std::move(r)), priority(p), hash(h),
+					size(1 + (left ? left->size : 0) + (right ? right->size : 0)) {}
+
+				const K key;
+				const NodePtr left;
+				const NodePtr right;
+				const uint64_t priority;
+				const size_t hash; //of the key and the two child pointers, its place in the table
+				const size_t size;
+			};
+
+			static const size_t kShards = 64;
+
+			struct Entry {
+				const Node *node;
+				std::weak_ptr<const Node> ref;
+			};
+
+			struct Shard {
+				std::mutex lock;
+				std::unordered_multimap<size_t, Entry> nodes;
+			};
+
+			struct Table {
+				Shard shards[kShards];
+			};
+
+			/*
+				the table is built in static storage on first use and never destroyed, so sets in
+				other static objects can still release their nodes at exit, whatever the order
+				of destruction
+			*/
+			static Table &Interned() {
+				static typename std::aligned_storage<sizeof(Table), alignof(Table)>::type storage;
+				static Table *table = new (&storage) Table();
+				return *table;
+			}
+
+			static Shard &ShardOf(size_t hash) {
+				return Interned().shards[(hash >> 7) % kShards];
+			}
+
+			//splitmix64 finalizer, so priorities look random even where std::hash is the identity
+			static uint64_t Mix(uint64_t x) {
+				x ^= x >> 30;
+				x *= 0xbf58476d1ce4e5b9ull;
+				x ^= x >> 27;
+				x *= 0x94d049bb133111ebull;
+				return x ^ (x >> 31);
+			}
+
+			static uint64_t Priority(const K &key) {
+				return Mix(std::hash<K>()(key));
+			}
+
+			//whether a key with priority pa belongs above one with pb, ties broken by key order
+			static bool Above(uint64_t pa, const K &a, uint64_t pb, const K &b) {
+				return pa != pb ? pa > pb : KeyCompare::Compare(a, b) < 0;
+			}
+
+			static size_t NodeHash(uint64_t priority, const Node *left, const Node *right) {
+				size_t h = (size_t)priority;
+				h ^= std::hash<const Node *>()(left) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+				h ^= std::hash<const Node *>()(right) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+				return h;
+			}
+
+			//frees the node and takes it out of the table; the children are released after the
+			//lock is dropped, since their deleters take the locks of their own shards
+			struct Release {
+				void operator()(const Node *node) const {
+					Shard &shard = ShardOf(node->hash);
+					{
+						std::lock_guard<std::mutex> g(shard.lock);
+						auto range = shard.nodes.equal_range(node->hash);
+						for (auto it = range.first; it != range.second; ++it) {
+							if (it->second.node == node) {
+								shard.nodes.erase(it);
+								break;
+							}
+						}
+						//an empty shard gives its buckets back
+						if (shard.nodes.empty()) {
+							std::unordered_multimap<size_t, Entry>().swap(shard.nodes);
+						}
+					}
+					delete node;
+				}
+			};
+
+			//the one node with this key and these children, made if there is none
+			static NodePtr Make(const K &key, const NodePtr &left, const NodePtr &right, uint64_t priority) {
+				const size_t h = NodeHash(priority, left.get(), right.get());
+				Shard &shard = ShardOf(h);
+				std::lock_guard<std::mutex> g(shard.lock);
+				auto range = shard.nodes.equal_range(h);
+				for (auto it = range.first; it != range.second; ++it) {
+					const Node *n = it->second.node;
+					if (n->left == left && n->right == right && KeyCompare::Compare(n->key, key) == 0) {
+						//null when the node is being released right now, then it is made anew
+						NodePtr live = it->second.ref.lock();
+						if (live) return live;
+					}
+				}
+				NodePtr n(new Node(key, left, right, priority, h), Release());
+				shard.nodes.emplace(h, Entry{ n.get(), n });
+				return n;
+			}
+
+			static NodePtr Remake(const Node *n, const NodePtr &left, const NodePtr &right) {
+				return Make(n->key, left, right, n->priority);
+			}
+
+			//t with key added, key not in t
+			static NodePtr Insert(const NodePtr &t, const K &key, uint64_t priority) {
+				if (!t) return Make(key, nullptr, nullptr, priority);
+				if (Above(priority, key, t->priority, t->key)) {
+					NodePtr left, right;
+					Split(t, key, left, right);
+					return Make(key, left, right, priority);
+				}
+				if (KeyCompare::Compare(key, t->key) < 0) return Remake(t.get(), Insert(t->left, key, priority), t->right);
+				return Remake(t.get(), t->left, Insert(t->right, key, priority));
+			}
+
+			//the keys of t below key into left and above it into right, key not in t
+			static void Split(const NodePtr &t, const K &key, NodePtr &left, NodePtr &right) {
+				if (!t) {
+					left = right = nullptr;
+					return;
+				}
+				if (KeyCompare::Compare(t->key, key) < 0) {
+					NodePtr rest;
+					Split(t->right, key, rest, right);
+					left = Remake(t.get(), t->left, rest);
+				} else {
+					NodePtr rest;
+					Split(t->left, key, left, rest);
+					right = Remake(t.get(), rest, t->right);
+				}
+			}
+
+			//t without key, key in t
+			static NodePtr Erase(const NodePtr &t, const K &key) {
+				const int c = KeyCompare::Compare(key, t->key);
+				if (c < 0) return Remake(t.get(), Erase(t->left, key), t->right);
+				if (c > 0) return Remake(t.get(), t->left, Erase(t->right, key));
+				return Join(t->left, t->right);
+			}
+
+			//the union of a and b, every key of a below every key of b
+			static NodePtr Join(const NodePtr &a, const NodePtr &b) {
+				if (!a) return b;
+				if (!b) return a;
+				if (Above(a->priority, a->key, b->priority, b->key)) return Remake(a.get(), a->left, Join(a->right, b));
+				return Remake(b.get(), Join(a, b->left), b->right);
+			}
+
+			template <class F>
+			static void ForEachImplementation(const Node *n, F &f) {
+				if (!n) return;
+				ForEachImplementation(n->left.get(), f);
+				f(n->key);
+				ForEachImplementation(n->right.get(), f);
+			}
+
+			explicit HashConsedSet(NodePtr root) : root_(std::move(root)) {}
+
+			NodePtr root_;
+	};
+
+}
+
+#endif
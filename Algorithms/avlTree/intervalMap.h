@@ -0,0 +1,114 @@
+#ifndef INTERVAL_MAP_H
+#define INTERVAL_MAP_H
+
+#include <limits>
+#include <utility>
+
+#include "avl.h"
+
+namespace avl {
+
+	//the half open interval [start, end), ordered by start and then by end
+	template <class T>
+	struct Interval {
+		T start;
+		T end;
+
+		friend bool operator<(const Interval& a, const Interval& b) {
+			return a.start < b.start || (!(b.start < a.start) && a.end < b.end);
+		}
+	};
+
+	//augment of an interval map, the largest end in a subtree
+	template <class T>
+	struct MaxEnd {
+		typedef T Value;
+		static T Identity() { return std::numeric_limits<T>::lowest(); }
+		template <class V>
+		static T Of(const Interval<T>& key, const V&) { return key.end; }
+		static T Combine(const T& a, const T& b) { return a < b ? b : a; }
+	};
+
+	/*
+		Persistent map from intervals [start, end) to values, an avl::AVL keyed by the interval,
+		so by start, with every node augmented with the largest end under it. Add and Remove path
+		copy like the tree's, and return the same map when they change nothing.
+		An interval is one key: adding the same [start, end) again replaces its value.
+
+		Stab(x, f) and Overlapping(lo, hi, f) call f(interval, value) for the intervals holding x,
+		or overlapping [lo, hi), in order of start. The walk skips every subtree whose largest end
+		is <= lo, since nothing in it reaches lo, and stops at the first start >= hi, since nothing
+		after it starts in time; so it only visits the paths to the k intervals it reports and
+		the two paths at the ends of the range, O(n) for a ForEach.
+		That is O(log n + k log(n / k)) nodes, which is weaker than O(log n + k): the paths to
+		k intervals scattered through the tree share only their top log k levels, and an interval
+		tree keyed on start has no way to skip the rest. The O(log n + k) bound needs a structure
+		that stores each interval more than once, like a segment tree or a priority search tree.
+	*/
+	template <class T, class V, class Policy = DefaultPolicy>
+	class IntervalMap {
+		public:
+			IntervalMap() {}
+
+			IntervalMap Add(T start, T end, V value, bool *changed = nullptr) const {
+				return IntervalMap(tree_.Add(Interval<T>{ std::move(start), std::move(end) }, std::move(value), changed));
+			}
+
+			IntervalMap Remove(const T &start, const T &end, bool *changed = nullptr) const {
+				return IntervalMap(tree_.Remove(Interval<T>{ start, end }, changed));
+			}
+
+			//value of exactly [start, end), or nullptr
+			const V *Find(const T &start, const T &end) const {
+				return tree_.Find(Interval<T>{ start, end });
+			}
+
+			//the intervals that hold x, start <= x < end
+			template <class F>
+			void Stab(const T &x, F &&f) const {
+				tree_.ForEachWhere(
+					[&](const T &maxEnd) { return x < maxEnd; },
+					[&](const Interval<T> &key) { return x < key.start; },
+					[&](const Interval<T> &key, const V &value) {
+						if (x < key.end) f(key, value);
+					});
+			}
+
+			//the intervals that overlap [lo, hi), start < hi and lo < end
+			template <class F>
+			void Overlapping(const T &lo, const T &hi, F &&f) const {
+				tree_.ForEachWhere(
+					[&](const T &maxEnd) { return lo < maxEnd; },
+					[&](const Interval<T> &key) { return !(key.start < hi); },
+					[&](const Interval<T> &key, const V &value) {
+						if (lo < key.end) f(key, value);
+					});
+			}
+
+			template <class F>
+			void ForEach(F &&f) const {
+				tree_.ForEach(std::forward<F>(f));
+			}
+
+			bool Empty() const {
+				return tree_.Empty();
+			}
+
+			bool SameRoot(const IntervalMap &other) const {
+				return tree_.SameRoot(other.tree_);
+			}
+
+		private:
+			struct Augmented : Policy {
+				typedef MaxEnd<T> Augment;
+			};
+			typedef AVL<Interval<T>, V, Augmented> Tree;
+
+			explicit IntervalMap(Tree tree) : tree_(std::move(tree)) {}
+
+			Tree tree_;
+	};
+
+}
+
+#endif
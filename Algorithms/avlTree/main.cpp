@@ -108,18 +108,24 @@ int main()
     avl.PrintPost();
 
     /*
-    The big O of the conversion from BST to AVL is O(n) because we have to loop through the entire BST tree to add each node to the AVL tree.
-    The insertion of the nodes into the AVL tree is O(log n) because we are using a binary search tree, as well as the fact that we are balancing the tree.
-    We use std::move to move the nodes from the BST tree to the AVL tree, so we are not copying the nodes, which would be O(n) if we were copying the nodes.
-    Also, std::move, is faster and more efficient than std::copy, so we are using the faster and more efficient method, especially if dealing with large numbers.
-    The big O of the deletion of the nodes from the AVL tree is O(log n) because we are using a binary search tree, as well as the fact that we are balancing the tree, just like in the previous example,
-    since we have to search through the tree to find the node we want to delete, and then we have to balance the tree after the deletion, but we make it more efficient depending on the height of the tree,
-    and the value itself, by searching from the head or the tail of the tree.
-
-    The space complexity of the insertion and deletion is O(n) because we are using a binary search tree, and we are storing the nodes in the tree, so the space complexity is O(n), where n is the number of nodes in the tree.
-    The space complexity of the conversion from BST to AVL is O(n), since we are moving the nodes from the BST to the AVL.
-
-    Converting a AVL to a BST is O(n) because we have to loop through the entire AVL tree to add each node to the BST tree, so they are equivalent in terms of time complexity.
+    The conversion from the BST to the AVL tree is O(n log n): we loop through all n keys, and every Add is O(log n),
+    since it walks down one path of the balanced tree and rebalances on the way back up.
+    Nothing is moved out of the BST. bstTree.Get(i) returns a copy of the key, and that copy is moved into the new AVL node.
+    The BST nodes themselves stay where they are, so the BST is still intact afterwards.
+    avl.Add does not change the tree either, it returns a new tree that shares every node with the old one except
+    the O(log n) nodes on the path to the new key, which are copied; assigning the result back to avl drops the old root,
+    and the shared_ptrs free the nodes only the old version used.
+    Removing a key is the same, O(log n) time and O(log n) new nodes, the successor (the head of the right subtree)
+    or the predecessor (the tail of the left subtree) replaces the key, taken from whichever side is taller.
+
+    The BST built by createTree is different: bst::BST::Add copies the whole tree to return a new one, so each Add is O(n),
+    and the 60 sorted inserts build a chain 60 nodes deep, where every lookup and insert is O(n) as well.
+
+    The space of one AVL tree is O(n), and each further version made by Add or Remove only costs its O(log n) new nodes.
+    Converting the AVL tree back to a BST is O(n) when the keys are inserted in pre order,
+    but with the copying Add of bst::BST it is O(n^2).
+
+    bench.cpp in this directory measures all of this, against std::map and std::set.
     */
 
    /*We will prove that both AVL trees are equal by inserting the elements of the BST tree in reverse order
@@ -0,0 +1,300 @@
+#ifndef SMALL_AVL_H
+#define SMALL_AVL_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "avl.h"
+
+namespace avl {
+
+	/*
+		avl::AVL for the many trees that stay small: under kSmallSize entries the entries are one
+		immutable sorted array instead of a node each, found by a linear scan, and a change copies
+		the array, at most kSmallSize - 1 entries, like a path copy copies the nodes on the path.
+		A tree that reaches kSmallSize entries moves into an avl::AVL, and one that shrinks below
+		kSmallSize / 2 goes back to an array, the gap keeping a tree that hovers around the threshold
+		from moving back and forth on every update.
+		Add, Remove, Find, ForEach and == behave as avl::AVL's, including returning the same tree,
+		see SameRoot, when an update changes nothing.
+		The array holds the entries in the slots of Policy::Values, like the tree's nodes, so with
+		SharedValues a copy of it copies handles, and moving between the two forms hands the same
+		slots over instead of copying the values.
+	*/
+	const size_t kSmallSize = 16;
+
+	//a == b where T has ==, otherwise values never count as equal, like avl::AVL
+	template <class T>
+	auto SameSmallValue(const T &a, const T &b, int) -> decltype(bool(a == b)) {
+		return a == b;
+	}
+
+	template <class T>
+	bool SameSmallValue(const T &, const T &, long) {
+		return false;
+	}
+
+	template <class K, class V = void, class Policy = DefaultPolicy>
+	class SmallAVL {
+		public:
+			SmallAVL() : size_(0) {}
+
+			SmallAVL Add(K key, V value, bool *changed = nullptr) const {
+				if (!tree_.Empty()) {
+					bool existed = false;
+					Tree tree = tree_.Upsert(std::move(key), [&](const V *current) {
+						existed = current != nullptr;
+						return std::move(value);
+					}, changed);
+					return SmallAVL(std::move(tree), existed ? size_ : size_ + 1);
+				}
+
+				const size_t i = LowerBound(key);
+				if (i < size_ && KeyCompare::Compare(KeyAt(i), key) == 0) {
+					const bool same = SameSmallValue((*small_)[i].get().second, value, 0);
+					if (changed) *changed = !same;
+					if (same) return *this;
+					std::shared_ptr<Array> entries = std::make_shared<Array>(*small_);
+					(*entries)[i] = Slot(std::move(key), std::move(value));
+					return SmallAVL(std::move(entries));
+				}
+
+				if (changed) *changed = true;
+				std::shared_ptr<Array> entries = std::make_shared<Array>();
+				entries->reserve(size_ + 1);
+				if (small_) entries->assign(small_->begin(), small_->begin() + i);
+				entries->emplace_back(std::move(key), std::move(value));
+				if (small_) entries->insert(entries->end(), small_->begin() + i, small_->end());
+				if (entries->size() == kSmallSize) {
+					return SmallAVL(Tree(Tree::FromSlots(entries->data(), kSmallSize)), kSmallSize);
+				}
+				return SmallAVL(std::move(entries));
+			}
+
+			template <typename LikeK>
+			SmallAVL Remove(const LikeK &key, bool *changed = nullptr) const {
+				bool removed = false;
+				if (!tree_.Empty()) {
+					Tree tree = tree_.Remove(key, &removed);
+					if (changed) *changed = removed;
+					if (!removed) return *this;
+					if (size_ - 1 >= kSmallSize / 2) return SmallAVL(std::move(tree), size_ - 1);
+					std::shared_ptr<Array> entries = std::make_shared<Array>();
+					entries->reserve(size_ - 1);
+					auto add = [&](const Slot &slot) { entries->push_back(slot); };
+					Tree::ForEachSlot(tree.root_.get(), add);
+					return SmallAVL(std::move(entries));
+				}
+
+				const size_t i = LowerBound(key);
+				removed = i < size_ && KeyCompare::Compare(KeyAt(i), key) == 0;
+				if (changed) *changed = removed;
+				if (!removed) return *this;
+				if (size_ == 1) return SmallAVL();
+				std::shared_ptr<Array> entries = std::make_shared<Array>(*small_);
+				entries->erase(entries->begin() + i);
+				return SmallAVL(std::move(entries));
+			}
+
+			//a pointer to the value of key, or nullptr
+			template <typename LikeK>
+			const V *Find(const LikeK &key) const {
+				if (!tree_.Empty()) return tree_.Find(key);
+				const size_t i = LowerBound(key);
+				return i < size_ && KeyCompare::Compare(KeyAt(i), key) == 0 ? &(*small_)[i].get().second : nullptr;
+			}
+
+			template <class F>
+			void ForEach(F &&f) const {
+				if (!tree_.Empty()) {
+					tree_.ForEach(std::forward<F>(f));
+					return;
+				}
+				for (size_t i = 0; i < size_; i++) {
+					const std::pair<K, V> &kv = (*small_)[i].get();
+					f(kv.first, kv.second);
+				}
+			}
+
+			bool Empty() const { return size_ == 0; }
+			size_t Size() const { return size_; }
+
+			//whether the entries are in an avl::AVL, for tests and measurements
+			bool IsTree() const { return !tree_.Empty(); }
+
+			bool SameRoot(const SmallAVL &other) const {
+				return small_ == other.small_ && tree_.SameRoot(other.tree_);
+			}
+
+			//the same entries, with keys equal by the comparator and values by ==, in either form
+			friend bool operator==(const SmallAVL &a, const SmallAVL &b) {
+				if (a.size_ != b.size_) return false;
+				if (a.SameRoot(b)) return true;
+				if (a.IsTree() && b.IsTree()) return a.tree_ == b.tree_;
+				const std::vector<Entry> left = a.Entries(), right = b.Entries();
+				for (size_t i = 0; i < left.size(); i++) {
+					if (KeyCompare::Compare(*left[i].first, *right[i].first) != 0) return false;
+					if (!(*left[i].second == *right[i].second)) return false;
+				}
+				return true;
+			}
+
+		private:
+			typedef AVL<K, V, Policy> Tree;
+			typedef typename Policy::Compare KeyCompare;
+			typedef typename Policy::Values::template Slot<K, V> Slot;
+			typedef std::vector<Slot> Array;
+			typedef std::pair<const K *, const V *> Entry;
+
+			explicit SmallAVL(std::shared_ptr<Array> entries) : small_(std::move(entries)), size_(small_->size()) {}
+			SmallAVL(Tree tree, size_t size) : tree_(std::move(tree)), size_(size) {}
+
+			//first entry whose key is not below key, by a linear scan
+			template <typename LikeK>
+			size_t LowerBound(const LikeK &key) const {
+				size_t i = 0;
+				while (i < size_ && KeyCompare::Compare(KeyAt(i), key) < 0) i++;
+				return i;
+			}
+
+			const K &KeyAt(size_t i) const {
+				return (*small_)[i].get().first;
+			}
+
+			//the entries in order, pointing into this tree
+			std::vector<Entry> Entries() const {
+				std::vector<Entry> entries;
+				entries.reserve(size_);
+				ForEach([&](const K &k, const V &v) { entries.emplace_back(&k, &v); });
+				return entries;
+			}
+
+			std::shared_ptr<const Array> small_;
+			Tree tree_;
+			size_t size_;
+	};
+
+	template <class K, class Policy>
+	class SmallAVL<K, void, Policy> {
+		public:
+			SmallAVL() : size_(0) {}
+
+			SmallAVL Add(K key, bool *changed = nullptr) const {
+				bool added = false;
+				if (!tree_.Empty()) {
+					Tree tree = tree_.Add(std::move(key), &added);
+					if (changed) *changed = added;
+					if (!added) return *this;
+					return SmallAVL(std::move(tree), size_ + 1);
+				}
+
+				const size_t i = LowerBound(key);
+				added = i == size_ || KeyCompare::Compare((*small_)[i], key) != 0;
+				if (changed) *changed = added;
+				if (!added) return *this;
+				if (size_ + 1 == kSmallSize) {
+					Tree tree;
+					for (size_t j = 0; j < size_; j++) {
+						if (j == i) tree = tree.Add(key);
+						tree = tree.Add((*small_)[j]);
+					}
+					if (i == size_) tree = tree.Add(std::move(key));
+					return SmallAVL(std::move(tree), kSmallSize);
+				}
+				std::shared_ptr<Array> keys = std::make_shared<Array>();
+				keys->reserve(size_ + 1);
+				if (small_) keys->assign(small_->begin(), small_->begin() + i);
+				keys->push_back(std::move(key));
+				if (small_) keys->insert(keys->end(), small_->begin() + i, small_->end());
+				return SmallAVL(std::move(keys));
+			}
+
+			SmallAVL Remove(const K &key, bool *changed = nullptr) const {
+				bool removed = false;
+				if (!tree_.Empty()) {
+					Tree tree = tree_.Remove(key, &removed);
+					if (changed) *changed = removed;
+					if (!removed) return *this;
+					if (size_ - 1 >= kSmallSize / 2) return SmallAVL(std::move(tree), size_ - 1);
+					std::shared_ptr<Array> keys = std::make_shared<Array>();
+					keys->reserve(size_ - 1);
+					tree.ForEach([&](const K &k) { keys->push_back(k); });
+					return SmallAVL(std::move(keys));
+				}
+
+				const size_t i = LowerBound(key);
+				removed = i < size_ && KeyCompare::Compare((*small_)[i], key) == 0;
+				if (changed) *changed = removed;
+				if (!removed) return *this;
+				if (size_ == 1) return SmallAVL();
+				std::shared_ptr<Array> keys = std::make_shared<Array>(*small_);
+				keys->erase(keys->begin() + i);
+				return SmallAVL(std::move(keys));
+			}
+
+			bool Lookup(const K &key) const {
+				if (!tree_.Empty()) return tree_.Lookup(key);
+				const size_t i = LowerBound(key);
+				return i < size_ && KeyCompare::Compare((*small_)[i], key) == 0;
+			}
+
+			template <class F>
+			void ForEach(F &&f) const {
+				if (!tree_.Empty()) {
+					tree_.ForEach(std::forward<F>(f));
+					return;
+				}
+				for (size_t i = 0; i < size_; i++) {
+					f((*small_)[i]);
+				}
+			}
+
+			bool Empty() const { return size_ == 0; }
+			size_t Size() const { return size_; }
+			bool IsTree() const { return !tree_.Empty(); }
+
+			bool SameRoot(const SmallAVL &other) const {
+				return small_ == other.small_ && tree_.SameRoot(other.tree_);
+			}
+
+			friend bool operator==(const SmallAVL &a, const SmallAVL &b) {
+				if (a.size_ != b.size_) return false;
+				if (a.SameRoot(b)) return true;
+				if (a.IsTree() && b.IsTree()) return a.tree_ == b.tree_;
+				const std::vector<const K *> left = a.Keys(), right = b.Keys();
+				for (size_t i = 0; i < left.size(); i++) {
+					if (KeyCompare::Compare(*left[i], *right[i]) != 0) return false;
+				}
+				return true;
+			}
+
+		private:
+			typedef AVL<K, void, Policy> Tree;
+			typedef typename Policy::Compare KeyCompare;
+			typedef std::vector<K> Array;
+
+			explicit SmallAVL(std::shared_ptr<Array> keys) : small_(std::move(keys)), size_(small_->size()) {}
+			SmallAVL(Tree tree, size_t size) : tree_(std::move(tree)), size_(size) {}
+
+			size_t LowerBound(const K &key) const {
+				size_t i = 0;
+				while (i < size_ && KeyCompare::Compare((*small_)[i], key) < 0) i++;
+				return i;
+			}
+
+			std::vector<const K *> Keys() const {
+				std::vector<const K *> keys;
+				keys.reserve(size_);
+				ForEach([&](const K &k) { keys.push_back(&k); });
+				return keys;
+			}
+
+			std::shared_ptr<const Array> small_;
+			Tree tree_;
+			size_t size_;
+	};
+
+}
+
+#endif
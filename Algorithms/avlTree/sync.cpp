@@ -0,0 +1,185 @@
+/*
+	Anti-entropy between two avl::AVL replicas over a pipe, with the EntryDigest policy.
+
+	Replica a holds the entries k -> k for n keys, and replica b is a copy of it with d keys removed,
+	d values changed and d keys added. b runs on its own thread and answers range digest requests
+	from a pipe, and a calls Reconcile with a remote that writes each request to the pipe and reads
+	the answer back, so a and b share nothing but the bytes on the pipes.
+
+	The ranges found are checked against the entries of both trees: every key whose entry differs
+	is in a range found, a one key range is a key that differs, and an open range holds no key of a
+	and some key of b. Prints the number of requests and ranges, and exits with 1 when a check fails.
+
+	usage: sync [n] [d] [seed], by default n = 1000000, d = 10, seed = 42
+*/
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <random>
+#include <thread>
+#include <cstdlib>
+#include <cstdint>
+#include <unistd.h>
+
+#include "avl.h"
+
+using namespace std;
+
+struct Replica : avl::DefaultPolicy {
+	typedef avl::EntryDigest Digest;
+};
+
+typedef avl::AVL<int, int, Replica> Tree;
+typedef avl::KeyRange<int> Range;
+
+//a request: which bounds it has, whether it is closed, and the bounds; kStop ends the server
+struct Request {
+	uint8_t flags;
+	int32_t lo;
+	int32_t hi;
+};
+
+const uint8_t kHasLo = 1, kHasHi = 2, kClosed = 4, kStop = 8;
+
+void WriteAll(int fd, const void* data, size_t n){
+	const char* p = (const char*)data;
+	while(n > 0){
+		ssize_t w = write(fd, p, n);
+		if(w <= 0){
+			perror("write");
+			exit(2);
+		}
+		p += w;
+		n -= w;
+	}
+}
+
+void ReadAll(int fd, void* data, size_t n){
+	char* p = (char*)data;
+	while(n > 0){
+		ssize_t r = read(fd, p, n);
+		if(r <= 0){
+			perror("read");
+			exit(2);
+		}
+		p += r;
+		n -= r;
+	}
+}
+
+//answer requests from in with the digests of tree, on out, until kStop
+void Serve(const Tree& tree, int in, int out){
+	for(;;){
+		Request q;
+		ReadAll(in, &q, sizeof(q));
+		if(q.flags & kStop)
+			return;
+		const int lo = q.lo, hi = q.hi;
+		const Range range = { (q.flags & kHasLo) ? &lo : nullptr, (q.flags & kHasHi) ? &hi : nullptr, (q.flags & kClosed) != 0 };
+		const uint64_t digest = tree.RangeDigest(range);
+		WriteAll(out, &digest, sizeof(digest));
+	}
+}
+
+bool InRange(int k, const Range& r){
+	if(r.lo && (r.closed ? k < *r.lo : k <= *r.lo))
+		return false;
+	if(r.hi && (r.closed ? k > *r.hi : k >= *r.hi))
+		return false;
+	return true;
+}
+
+int main(int argc, char* argv[]){
+	const int n = argc > 1 ? atoi(argv[1]) : 1000000;
+	const int d = argc > 2 ? atoi(argv[2]) : 10;
+	const unsigned long long seed = argc > 3 ? strtoull(argv[3], NULL, 10) : 42;
+	if(n < 1 || d < 0 || 2 * d > n){
+		cerr << "usage: sync [n] [d] [seed], with 2d <= n" << endl;
+		return 2;
+	}
+
+	Tree a;
+	for(int k = 0; k < n; k++){
+		a = a.Add(k, k);
+	}
+	Tree b = a;
+	mt19937_64 rng(seed);
+	vector<int> keys(n);
+	for(int k = 0; k < n; k++){
+		keys[k] = k;
+	}
+	shuffle(keys.begin(), keys.end(), rng);
+	for(int i = 0; i < d; i++){
+		b = b.Remove(keys[i]);
+		b = b.Add(keys[d + i], -1);
+		b = b.Add(n + i, n + i);
+	}
+
+	int toServer[2], toClient[2];
+	if(pipe(toServer) != 0 || pipe(toClient) != 0){
+		perror("pipe");
+		return 2;
+	}
+	thread server(Serve, cref(b), toServer[0], toClient[1]);
+
+	size_t requests = 0;
+	auto remote = [&](const Range& r){
+		Request q = { (uint8_t)((r.lo ? kHasLo : 0) | (r.hi ? kHasHi : 0) | (r.closed ? kClosed : 0)),
+			r.lo ? *r.lo : 0, r.hi ? *r.hi : 0 };
+		WriteAll(toServer[1], &q, sizeof(q));
+		uint64_t digest;
+		ReadAll(toClient[0], &digest, sizeof(digest));
+		requests++;
+		return digest;
+	};
+	vector<Range> found; //the bounds point into a, which outlives found
+	a.Reconcile(remote, [&](const Range& r){ found.push_back(r); });
+
+	const Request stop = { kStop, 0, 0 };
+	WriteAll(toServer[1], &stop, sizeof(stop));
+	server.join();
+
+	//the differing keys, by comparing the two trees entry by entry
+	map<int, int> ea, eb;
+	a.ForEach([&](const int& k, const int& v){ ea[k] = v; });
+	b.ForEach([&](const int& k, const int& v){ eb[k] = v; });
+	vector<int> differing;
+	for(auto& kv : ea){
+		auto it = eb.find(kv.first);
+		if(it == eb.end() || it->second != kv.second)
+			differing.push_back(kv.first);
+	}
+	for(auto& kv : eb){
+		if(ea.count(kv.first) == 0)
+			differing.push_back(kv.first);
+	}
+
+	bool correct = true;
+	for(int k : differing){
+		bool covered = false;
+		for(const Range& r : found){
+			covered |= InRange(k, r);
+		}
+		correct &= covered;
+	}
+	for(const Range& r : found){
+		if(r.closed){
+			auto it = eb.find(*r.lo);
+			correct &= it == eb.end() || it->second != ea[*r.lo];
+		} else {
+			bool inA = false, inB = false;
+			for(auto& kv : ea){
+				inA |= InRange(kv.first, r);
+			}
+			for(auto& kv : eb){
+				inB |= InRange(kv.first, r);
+			}
+			correct &= !inA && inB;
+		}
+	}
+
+	cout << "n " << n << ", differing keys " << differing.size() << ", ranges found " << found.size()
+		<< ", requests " << requests << ", " << (correct ? "correct" : "WRONG") << endl;
+	return correct ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+/*
+	Fork-join thread pool with work stealing, for the parallel walks of avl::AVL.
+
+	Run(f) runs f with the calling thread as worker 0 and returns when f is done. Inside it,
+	Join(a, b) runs a and b, possibly at the same time: b is pushed on the back of the worker's
+	own deque, a runs right away, and then b is taken back and run if no other worker stole it
+	from the front of the deque in the meantime. A worker waiting for a stolen b runs other
+	tasks instead of blocking, so a join never leaves a core idle while there is work, and a
+	worker with nothing to do steals the oldest task of another, which near the root of a
+	recursion is the biggest one.
+	Tasks live on the stack of the Join that made them, so forking costs no allocation.
+	Idle workers sleep until a task is pushed.
+
+	An exception from a or b comes out of the Join, and so out of Run. A Join never returns or
+	throws while its b is still in a deque or running on another worker, since b lives on its
+	stack: when a throws, b is taken back, or waited for if it was stolen, before the exception
+	goes on; b's own exception is then dropped.
+
+	Runs from different threads on one pool take turns, the caller of Run is always worker 0:
+	a parallel walk started while another runs waits for it to finish. Threads that need to
+	walk at the same time should each use a pool of their own.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class WorkPool
+{
+public:
+	//threads workers counting the caller of Run, 0 for one per core
+	explicit WorkPool(unsigned threads = 0) : queued(0), stopping(false)
+	{
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned i = 0; i < threads; i++)
+			workers.emplace_back(new Worker());
+		for (unsigned i = 1; i < threads; i++)
+			pool.emplace_back([this, i] { Loop(i); });
+	}
+
+	~WorkPool()
+	{
+		{
+			std::lock_guard<std::mutex> g(sleepLock);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread &t : pool)
+			t.join();
+	}
+
+	WorkPool(const WorkPool &) = delete;
+	WorkPool &operator=(const WorkPool &) = delete;
+
+	//one pool of a worker per core, made on first use
+	static WorkPool &Shared()
+	{
+		static WorkPool shared;
+		return shared;
+	}
+
+	unsigned Threads() const { return (unsigned)workers.size(); }
+
+	//run f on the pool, one Run at a time, see above; a Run from inside a task just calls f
+	template <class F>
+	void Run(F &&f)
+	{
+		Current &here = Here();
+		if (here.pool == this)
+		{
+			f();
+			return;
+		}
+		std::lock_guard<std::mutex> g(runLock);
+		const Current outer = here;
+		here = Current{this, 0};
+		try
+		{
+			f();
+		}
+		catch (...)
+		{
+			here = outer;
+			throw;
+		}
+		here = outer;
+	}
+
+	//run a and b, maybe in parallel, from inside Run
+	template <class A, class B>
+	void Join(A &&a, B &&b)
+	{
+		const int self = Here().worker;
+		Task task;
+		typedef typename std::remove_reference<B>::type Fn;
+		task.run = [](void *f) { (*static_cast<Fn *>(f))(); };
+		task.arg = (void *)&b;
+		Push(self, &task);
+		try
+		{
+			a();
+		}
+		catch (...)
+		{
+			if (!TakeBack(self, &task))
+				Wait(self, task);
+			throw;
+		}
+		if (TakeBack(self, &task))
+		{
+			b();
+			return;
+		}
+		Wait(self, task);
+		if (task.error)
+			std::rethrow_exception(task.error);
+	}
+
+private:
+	struct Task
+	{
+		void (*run)(void *);
+		void *arg;
+		std::atomic<bool> done{false};
+		std::exception_ptr error; //thrown by run on the worker that stole it
+	};
+
+	struct Worker
+	{
+		std::mutex lock;
+		std::deque<Task *> tasks;
+	};
+
+	struct Current
+	{
+		WorkPool *pool;
+		int worker;
+	};
+
+	static Current &Here()
+	{
+		thread_local Current current = {nullptr, -1};
+		return current;
+	}
+
+	void Push(int self, Task *task)
+	{
+		{
+			std::lock_guard<std::mutex> g(workers[self]->lock);
+			workers[self]->tasks.push_back(task);
+		}
+		queued.fetch_add(1, std::memory_order_release);
+		{
+			//taken so the push cannot fall between a sleeper's check and its wait
+			std::lock_guard<std::mutex> g(sleepLock);
+		}
+		wake.notify_one();
+	}
+
+	bool TakeBack(int self, Task *task)
+	{
+		std::lock_guard<std::mutex> g(workers[self]->lock);
+		std::deque<Task *> &tasks = workers[self]->tasks;
+		if (tasks.empty() || tasks.back() != task)
+			return false;
+		tasks.pop_back();
+		queued.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	//newest task of this worker, or the oldest of another
+	Task *Find(int self)
+	{
+		const int n = (int)workers.size();
+		for (int i = 0; i < n; i++)
+		{
+			const int w = (self + i) % n;
+			std::lock_guard<std::mutex> g(workers[w]->lock);
+			std::deque<Task *> &tasks = workers[w]->tasks;
+			if (tasks.empty())
+				continue;
+			Task *task;
+			if (i == 0)
+			{
+				task = tasks.back();
+				tasks.pop_back();
+			}
+			else
+			{
+				task = tasks.front();
+				tasks.pop_front();
+			}
+			queued.fetch_sub(1, std::memory_order_relaxed);
+			return task;
+		}
+		return nullptr;
+	}
+
+	bool RunOne(int self)
+	{
+		Task *task = Find(self);
+		if (task == nullptr)
+			return false;
+		try
+		{
+			task->run(task->arg);
+		}
+		catch (...)
+		{
+			task->error = std::current_exception();
+		}
+		task->done.store(true, std::memory_order_release);
+		return true;
+	}
+
+	//until another worker has run task, running other tasks meanwhile
+	void Wait(int self, const Task &task)
+	{
+		while (!task.done.load(std::memory_order_acquire))
+		{
+			if (!RunOne(self))
+				std::this_thread::yield();
+		}
+	}
+
+	void Loop(int self)
+	{
+		Here() = Current{this, self};
+		for (;;)
+		{
+			if (RunOne(self))
+				continue;
+			std::unique_lock<std::mutex> g(sleepLock);
+			wake.wait(g, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+			if (stopping)
+				return;
+		}
+	}
+
+	std::vector<std::unique_ptr<Worker>> workers; //0 is the thread in Run
+	std::vector<std::thread> pool;
+	std::atomic<size_t> queued; //tasks in all the deques
+	std::mutex sleepLock;
+	std::condition_variable wake;
+	bool stopping;
+	std::mutex runLock;
+};
+
+#endif
@@ -0,0 +1,77 @@
+//Day-Stout-Warren rebuild for binary trees of nodes with left and right members
+//shared by the rebalancing in question2 and the AVL conversion in question5
+
+#ifndef DSW_H
+#define DSW_H
+
+#include <cstddef>
+
+/*
+    The rebuild works below a pseudo root, a spare node whose right link holds the tree,
+    so the root can change without special cases. It takes two passes over the same nodes,
+    O(n) time and no allocation:
+    1. treeToVine rotates the tree into a vine, a chain of right children in in-order sequence
+    2. vineToTree folds the vine back into a perfectly balanced tree with left rotations
+    The in-order sequence never changes, so a tree that was sorted stays sorted. The shape does,
+    so where a tree kept equal keys on one side, after a rebuild they can be on either side.
+*/
+
+//rotate everything below the pseudo root into a vine, returns the number of nodes
+template <class Node>
+int treeToVine(Node *pseudoRoot)
+{
+    int count = 0;
+    Node *tail = pseudoRoot;
+    Node *rest = tail->right;
+    while (rest != NULL)
+    {
+	if (rest->left == NULL)
+	{
+	    tail = rest;
+	    rest = rest->right;
+	    count++;
+	}
+	else
+	{
+	    //rotate right around rest, pulling its left child up into the vine
+	    Node *temp = rest->left;
+	    rest->left = temp->right;
+	    temp->right = rest;
+	    rest = temp;
+	    tail->right = temp;
+	}
+    }
+    return count;
+}
+
+//left rotate every other node of the vine, for count rotations
+template <class Node>
+void compressVine(Node *pseudoRoot, int count)
+{
+    Node *scanner = pseudoRoot;
+    for (int i = 0; i < count; i++)
+    {
+	Node *child = scanner->right;
+	scanner->right = child->right;
+	scanner = scanner->right;
+	child->right = scanner->left;
+	scanner->left = child;
+    }
+}
+
+//turn the vine of size nodes below the pseudo root into a perfectly balanced tree
+template <class Node>
+void vineToTree(Node *pseudoRoot, int size)
+{
+    //the leaves that do not fit in the largest full tree go first
+    int full = 1;
+    while (full <= size)
+	full = 2 * full + 1;
+    full /= 2;
+    compressVine(pseudoRoot, size - full);
+
+    for (int m = full / 2; m > 0; m /= 2)
+	compressVine(pseudoRoot, m);
+}
+
+#endif
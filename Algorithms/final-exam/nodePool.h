@@ -0,0 +1,94 @@
+//arena for the tree nodes of the final exam programs
+//nodes are bump allocated out of large blocks, and a whole tree is freed at once by
+//dropping the blocks, instead of deleting node by node
+
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+    Nodes come out of blocks of contiguous memory, so nodes allocated one after another sit
+    next to each other and a traversal walks through memory mostly in order.
+    Blocks double in size, from firstBlock nodes up to 1M nodes per block, so a pool of n nodes
+    holds only O(log n) blocks.
+
+    reset() rewinds the pool and keeps its largest block for the next tree,
+    release() (and the destructor) hands all the blocks back to the system.
+    Both cost one free per block and nothing per node, since neither runs the destructors
+    of the nodes, which is the point: a tree in the pool is torn down without visiting it.
+    So a node that came from a pool must never be deleted, and nothing it owns outside
+    the pool gets freed.
+*/
+template <class T>
+class NodePool
+{
+public:
+    explicit NodePool(size_t firstBlock = 1024) : firstBlock(firstBlock), used(0), capacity(0), count(0) {}
+    ~NodePool() { release(); }
+
+    //the pool owns its blocks, so it cannot be copied
+    NodePool(const NodePool &) = delete;
+    NodePool &operator=(const NodePool &) = delete;
+
+    //construct a node in the pool, with whatever arguments T's constructor takes
+    template <class... Args>
+    T *make(Args &&...args)
+    {
+	return new (allocate()) T(std::forward<Args>(args)...);
+    }
+
+    //raw storage for one node
+    void *allocate()
+    {
+	if (used == capacity)
+	    grow();
+	count++;
+	return blocks.back() + sizeof(T) * used++;
+    }
+
+    //forget every node but keep the biggest block for reuse
+    void reset()
+    {
+	for (size_t i = 0; i + 1 < blocks.size(); i++)
+	    ::operator delete(blocks[i]);
+	if (blocks.size() > 1)
+	    blocks.erase(blocks.begin(), blocks.end() - 1);
+	used = 0;
+	count = 0;
+    }
+
+    //forget every node and free all the memory
+    void release()
+    {
+	for (size_t i = 0; i < blocks.size(); i++)
+	    ::operator delete(blocks[i]);
+	blocks.clear();
+	used = 0;
+	capacity = 0;
+	count = 0;
+    }
+
+    //number of nodes handed out since the last reset
+    size_t size() const { return count; }
+
+private:
+    void grow()
+    {
+	const size_t maxBlock = size_t(1) << 20;
+	capacity = blocks.empty() ? firstBlock : (capacity < maxBlock ? capacity * 2 : maxBlock);
+	blocks.push_back(static_cast<char *>(::operator new(sizeof(T) * capacity)));
+	used = 0;
+    }
+
+    std::vector<char *> blocks;
+    size_t firstBlock;
+    size_t used;	 //nodes used in the last block
+    size_t capacity; //nodes that fit in the last block
+    size_t count;
+};
+
+#endif
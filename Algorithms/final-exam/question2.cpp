@@ -9,6 +9,16 @@ There must be no duplicate nodes for the tree to be a valid BST */
 
 //general include statements
 #include <iostream>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include "nodePool.h"
+#include "traversal.h"
+#include "dsw.h"
 
 using namespace std;
 
@@ -31,13 +41,39 @@ class BST
 	//destructor
 	~BST();
 
-	//insert function
-	BST* Insert(BST*, int);
+	//insert function, nodes come from the pool when one is given, otherwise from new
+	BST* Insert(BST*, int, NodePool<BST>* = NULL);
 
 	//inorder traversal function
 	void Inorder(BST*);
+
+	//rebuild the tree into a perfectly balanced one, returns the new root
+	BST* Rebalance(BST*);
+
+	//insert that keeps the depth below kDepthFactor * log2(count), count is the number of nodes
+	BST* InsertBalanced(BST*, int, int&, NodePool<BST>* = NULL);
+
+    private:
+	//how deep a node may land, relative to log2 of the node count, before a subtree is rebuilt
+	static const double kDepthFactor;
+
+	//deepest path InsertBalanced can record, enough for 2^63 nodes at kDepthFactor 2
+	static const int kMaxPath = 128;
+
+	//the shared traversal and Day-Stout-Warren helpers walk and relink the private links
+	template <class Node, class Visit> friend void morrisInorder(Node*, Visit&&);
+	template <class Node> friend int treeToVine(Node*);
+	template <class Node> friend void compressVine(Node*, int);
+
+	//helpers for the rebalance
+	static BST* RebuildSubtree(BST*);
+	static int Size(BST*);
+	static BST* MakeNode(int, NodePool<BST>*);
 };
 
+//2 * log2(n) allows each subtree to be up to 2^(-1/2), about 71%, of its parent before a rebuild
+const double BST::kDepthFactor = 2.0;
+
 //default constructor
 //sets data to 0 and left and right to NULL, so this can be our root node
 BST::BST() : data(0), left(NULL), right(NULL)
@@ -62,30 +98,39 @@ BST::~BST()
 	delete right;
 }
 
+//allocate a node, from the pool if there is one
+//a tree built from a pool is freed by releasing the pool, never by deleting its root,
+//the recursive destructor would try to delete nodes the pool owns
+BST* BST::MakeNode(int value, NodePool<BST>* pool)
+{
+	return pool ? pool->make(value) : new BST(value);
+}
+
 //insert function
 //this function inserts a new node into the BST, which is called when we want to create a new node
 //this function returns a pointer to the root node for which we are creating a child
 //this function takes in a pointer to the root node and the value to be inserted
-BST* BST::Insert(BST* root, int value)
+//and optionally the pool to take the new node from
+BST* BST::Insert(BST* root, int value, NodePool<BST>* pool)
 {
 	//if the root is NULL, then we are at the root node
 	if (!root)
 	{
 		//return a new BST with the value passed in
-		return new BST(value);
+		return MakeNode(value, pool);
 	}
 
 	//if the value passed in is less than the root's data
 	if (value < root->data)
 	{
 		//insert the value into the left subtree
-		root->left = Insert(root->left, value);
+		root->left = Insert(root->left, value, pool);
 	}
 	//if the value passed in is greater than the root's data
 	else
 	{
 		//insert the value into the right subtree
-		root->right = Insert(root->right, value);
+		root->right = Insert(root->right, value, pool);
 	}
 
 	//return the root node
@@ -94,29 +139,183 @@ BST* BST::Insert(BST* root, int value)
 
 //inorder traversal function
 //this function prints the BST in order, by taking a pointer to the root node
-//this function is recursive
+//this function is iterative, a Morris traversal from traversal.h, so it needs no stack however deep the tree is
 void BST::Inorder(BST* root)
 {
-	//if the root is NULL, then we are at the end of the tree
+	morrisInorder(root, [](BST* node) { cout << node->data << endl; });
+}
+
+//rebalance the subtree below root in place and return its new root
+BST* BST::RebuildSubtree(BST* root)
+{
+	BST pseudoRoot;
+	pseudoRoot.right = root;
+	int size = treeToVine(&pseudoRoot);
+	vineToTree(&pseudoRoot, size);
+
+	//detach before pseudoRoot's destructor runs, it does not own the tree
+	BST* result = pseudoRoot.right;
+	pseudoRoot.right = NULL;
+	return result;
+}
+
+//rebalance function
+//this is the Day-Stout-Warren algorithm, it rotates the tree into a vine and then folds
+//the vine back into a perfectly balanced tree, O(n) time and O(1) extra space
+//the root node can change, so it returns the new one
+//the in-order sequence is kept, but Insert's rule that equal keys go right is not:
+//a rebuilt node can have a key equal to its own in its left subtree as well as its right,
+//so inserting and printing stay correct, while a search for every copy of a key must look both ways
+BST* BST::Rebalance(BST* root)
+{
+	return RebuildSubtree(root);
+}
+
+//number of nodes below root, counted with the same Morris traversal as Inorder so it needs no stack
+int BST::Size(BST* root)
+{
+	int count = 0;
+	morrisInorder(root, [&count](BST*) { count++; });
+	return count;
+}
+
+//balanced insert function
+//inserts like Insert, but if the new node lands deeper than kDepthFactor * log2(count),
+//walks back up its path to the first ancestor where one side holds too large a share
+//of the nodes (the scapegoat) and rebuilds just that subtree with the DSW rebalance
+//there are no rotations on the normal path, and the rebuilds cost O(log n) amortized per insert
+//as with Rebalance, equal keys can end up on both sides of a rebuilt subtree
+//count is the number of nodes in the tree, it is incremented here
+BST* BST::InsertBalanced(BST* root, int value, int& count, NodePool<BST>* pool)
+{
+	count++;
 	if (!root)
 	{
-		//return
-		return;
+		return MakeNode(value, pool);
+	}
+
+	//walk down, remembering the path
+	BST* path[kMaxPath];
+	int depth = 0;
+	BST* node = root;
+	while (true)
+	{
+		if (depth < kMaxPath)
+		{
+			path[depth] = node;
+		}
+		depth++;
+
+		BST*& next = (value < node->data) ? node->left : node->right;
+		if (!next)
+		{
+			next = MakeNode(value, pool);
+			break;
+		}
+		node = next;
+	}
+
+	//depth is the number of edges from the root to the new node
+	const double limit = kDepthFactor * log2((double)count);
+	if (depth <= limit)
+	{
+		return root;
+	}
+
+	//a tree built with plain Insert can be deeper than the recorded path, rebuild all of it
+	if (depth > kMaxPath)
+	{
+		return Rebalance(root);
+	}
+
+	//climb until a child holds more than 2^(-1/kDepthFactor) of its parent's nodes
+	const double alpha = pow(2.0, -1.0 / kDepthFactor);
+	BST* child = (value < path[depth - 1]->data) ? path[depth - 1]->left : path[depth - 1]->right;
+	int childSize = 1;
+	for (int i = depth - 1; i >= 0; i--)
+	{
+		BST* parent = path[i];
+		BST* sibling = (child == parent->left) ? parent->right : parent->left;
+		int parentSize = childSize + 1 + Size(sibling);
+
+		if (childSize > alpha * parentSize)
+		{
+			BST* rebuilt = RebuildSubtree(parent);
+			if (i == 0)
+			{
+				return rebuilt;
+			}
+			if (path[i - 1]->left == parent)
+			{
+				path[i - 1]->left = rebuilt;
+			}
+			else
+			{
+				path[i - 1]->right = rebuilt;
+			}
+			return root;
+		}
+
+		child = parent;
+		childSize = parentSize;
+	}
+
+	//no scapegoat on the path, only possible if count was wrong, so rebuild everything
+	return Rebalance(root);
+}
+
+//build a tree of n random keys with new and with a pool, and time tearing each one down
+//the deletes run the recursive destructor once per node, the pool drops its blocks
+void Benchmark(int n)
+{
+	BST tree;
+	mt19937 rng(1);
+	vector<int> keys(n);
+	for (int i = 0; i < n; i++)
+	{
+		keys[i] = (int)rng();
 	}
 
-	//print the left subtree
-	Inorder(root->left);
+	auto time = [](auto&& f) {
+		auto start = chrono::steady_clock::now();
+		f();
+		return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	};
 
-	//print the root's data
-	cout << root->data << endl;
+	BST* heapRoot = NULL;
+	double heapBuild = time([&] {
+		for (int i = 0; i < n; i++)
+		{
+			heapRoot = tree.Insert(heapRoot, keys[i]);
+		}
+	});
+	double heapTeardown = time([&] { delete heapRoot; });
 
-	//print the right subtree
-	Inorder(root->right);
+	NodePool<BST> pool;
+	BST* poolRoot = NULL;
+	double poolBuild = time([&] {
+		for (int i = 0; i < n; i++)
+		{
+			poolRoot = tree.Insert(poolRoot, keys[i], &pool);
+		}
+	});
+	double poolTeardown = time([&] { pool.release(); });
+
+	cout << n << " random keys" << endl;
+	cout << "new:  build " << heapBuild << " ms, teardown " << heapTeardown << " ms" << endl;
+	cout << "pool: build " << poolBuild << " ms, teardown " << poolTeardown << " ms" << endl;
 }
 
 //driver code
-int main()
+//run with "bench [nodes]" to compare heap and pool allocated trees instead
+int main(int argc, char* argv[])
 {
+	if (argc > 1 && strcmp(argv[1], "bench") == 0)
+	{
+		Benchmark(argc > 2 ? atoi(argv[2]) : 2000000);
+		return 0;
+	}
+
 	//create a new BST
 	BST tree, *root = NULL;
 
@@ -132,6 +331,25 @@ int main()
 	//print the BST
 	tree.Inorder(root);
 
+	//inserting in sorted order builds a chain, rebalancing folds it into a balanced tree
+	BST *chain = NULL;
+	for (int i = 1; i <= 15; i++)
+	{
+		chain = tree.Insert(chain, i);
+	}
+	chain = tree.Rebalance(chain);
+	cout << "rebalanced:" << endl;
+	tree.Inorder(chain);
+
+	//the balanced insert rebuilds a subtree whenever a node lands too deep, so this never becomes a chain
+	BST *balanced = NULL;
+	int count = 0;
+	for (int i = 1; i <= 1000; i++)
+	{
+		balanced = tree.InsertBalanced(balanced, i, count);
+	}
+	cout << "inserted " << count << " sorted keys with InsertBalanced" << endl;
+
 	return 0;
 }
 
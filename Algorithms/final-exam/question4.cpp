@@ -3,6 +3,13 @@
 //the tree is unordered
 
 #include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include "traversal.h"
+#include "nodePool.h"
 
 using namespace std;
 
@@ -14,10 +21,14 @@ struct node
     node *right;
 };
 
+//every node of the program comes from this pool, and is freed with it at exit,
+//or all at once by nodes.release()
+NodePool<node> nodes;
+
 //function to create a new node
 node *newNode(char data)
 {
-    node *temp = new node;
+    node *temp = nodes.make();
     temp->data = data;
     temp->left = NULL;
     temp->right = NULL;
@@ -57,9 +68,95 @@ void postorder(node *root)
     }
 }
 
+//random shaped tree of n nodes, each new node hangs off a random empty link
+//its expected height is O(log n), so the recursive printers can still walk it
+node *randomTree(int n)
+{
+    if (n == 0)
+	return NULL;
+    node *root = newNode('a');
+    srand(1);
+    for (int i = 1; i < n; i++)
+    {
+	node *n = root;
+	while (true)
+	{
+	    node *&next = (rand() & 1) ? n->left : n->right;
+	    if (next == NULL)
+	    {
+		next = newNode('a' + i % 26);
+		break;
+	    }
+	    n = next;
+	}
+    }
+    return root;
+}
+
+//a chain of n left children, the worst case for recursion
+node *skewedTree(int n)
+{
+    node *root = NULL;
+    for (int i = 0; i < n; i++)
+    {
+	node *n = newNode('a' + i % 26);
+	n->left = root;
+	root = n;
+    }
+    return root;
+}
+
+//time one traversal, the output goes to stdout and the time to stderr
+template <class F>
+void timeTraversal(const char *name, F &&f)
+{
+    auto start = chrono::steady_clock::now();
+    f();
+    cout.flush();
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cerr << name << ": " << ms << " ms" << endl;
+}
+
+//compare the recursive printers with the traversal engines and the buffered sink
+//run as "question4 bench [nodes] > /dev/null", timings are written to stderr
+void benchmark(int n)
+{
+    vector<node *> stack;
+    node *balanced = randomTree(n);
+    node *skewed = skewedTree(n);
+
+    cerr << n << " nodes, random shape" << endl;
+    timeTraversal("recursive inorder", [&] { inorder(balanced); });
+    timeTraversal("morris inorder + sink", [&] { BufferedSink sink; morrisInorder(balanced, sink); });
+    timeTraversal("stack inorder + sink", [&] { BufferedSink sink; stackInorder(balanced, sink, stack); });
+    timeTraversal("recursive preorder", [&] { preorder(balanced); });
+    timeTraversal("morris preorder + sink", [&] { BufferedSink sink; morrisPreorder(balanced, sink); });
+    timeTraversal("stack preorder + sink", [&] { BufferedSink sink; stackPreorder(balanced, sink, stack); });
+    timeTraversal("recursive postorder", [&] { postorder(balanced); });
+    timeTraversal("morris postorder + sink", [&] { BufferedSink sink; morrisPostorder(balanced, sink); });
+    timeTraversal("stack postorder + sink", [&] { BufferedSink sink; stackPostorder(balanced, sink, stack); });
+
+    //the recursive printers would need one stack frame per node here, so they are not run
+    cerr << n << " nodes, skewed (recursive versions skipped, they overflow the stack)" << endl;
+    timeTraversal("morris inorder + sink", [&] { BufferedSink sink; morrisInorder(skewed, sink); });
+    timeTraversal("stack inorder + sink", [&] { BufferedSink sink; stackInorder(skewed, sink, stack); });
+    timeTraversal("morris postorder + sink", [&] { BufferedSink sink; morrisPostorder(skewed, sink); });
+    timeTraversal("stack postorder + sink", [&] { BufferedSink sink; stackPostorder(skewed, sink, stack); });
+
+    //both trees are in the node pool, so tearing them down is a few frees, not one delete per node
+    cerr << nodes.size() << " nodes in the pool" << endl;
+    timeTraversal("pool release", [&] { nodes.release(); });
+}
+
 //create the tree in the main function, insert some nodes, and print
-int main()
+int main(int argc, char *argv[])
 {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
+    {
+	benchmark(argc > 2 ? atoi(argv[2]) : 4000000);
+	return 0;
+    }
+
     node *root = newNode('A');
     root->left = newNode('B');
     root->left->left = newNode('C');
@@ -5,6 +5,10 @@
 
 #include <iostream>
 
+#include "traversal.h"
+#include "nodePool.h"
+#include "dsw.h"
+
 using namespace std;
 
 struct node
@@ -14,9 +18,12 @@ struct node
     node *right;
 };
 
+//all the nodes come from this pool and are freed with it at exit, never one by one
+NodePool<node> nodes;
+
 node *newNode(char data)
 {
-    node *temp = new node;
+    node *temp = nodes.make();
     temp->data = data;
     temp->left = NULL;
     temp->right = NULL;
@@ -24,93 +31,72 @@ node *newNode(char data)
 }
 
 //print the tree in order
+//the traversals are iterative and write through a buffered sink, see traversal.h
 void printInorder(node *root)
 {
-    if (root == NULL)
-	return;
-    printInorder(root->left);
-    cout << root->data << " ";
-    printInorder(root->right);
+    BufferedSink sink;
+    morrisInorder(root, sink);
 }
 
 //print the tree in preorder
 void printPreorder(node *root)
 {
-    if (root == NULL)
-	return;
-    cout << root->data << " ";
-    printPreorder(root->left);
-    printPreorder(root->right);
+    BufferedSink sink;
+    morrisPreorder(root, sink);
 }
 
 //print the tree in postorder
 void printPostorder(node *root)
 {
-    if (root == NULL)
-	return;
-    printPostorder(root->left);
-    printPostorder(root->right);
-    cout << root->data << " ";
+    BufferedSink sink;
+    morrisPostorder(root, sink);
 }
 
-//function to conver the unordered tree to an AVL tree
-node *convertToAVL(node *root)
+/*
+    converting the unordered tree to an AVL tree happens in three passes over the same nodes,
+    O(n) time in total and no allocation, the Day-Stout-Warren way, see dsw.h:
+    1. rotate the tree into a vine, a chain of right children, keeping the in-order sequence
+    2. counting sort the keys along the vine, since a char only has 256 possible values
+    3. compress the vine back into a perfectly balanced tree with left rotations
+    the result is a binary search tree whose levels are all full except the last,
+    so the heights of the two subtrees of every node differ by at most 1
+*/
+
+//sort the keys along the vine in place, the nodes stay where they are
+void countingSortVine(node *vine)
 {
-    //if the tree is empty
-    if (root == NULL)
-	return root;
-    //if the tree has only one node
-    if (root->left == NULL && root->right == NULL)
-	return root;
-    //if the tree has two nodes
-    if (root->left != NULL && root->right != NULL)
-    {
-	//if the left node is greater than the right node
-	if (root->left->data > root->right->data)
-	{
-	    //swap the data
-	    char temp = root->left->data;
-	    root->left->data = root->right->data;
-	    root->right->data = temp;
-	}
-    }
-    //if the tree has only one node on the left
-    if (root->left != NULL && root->right == NULL)
-    {
-	//if the left node is greater than the root node
-	if (root->left->data > root->data)
-	{
-	    //swap the data
-	    char temp = root->left->data;
-	    root->left->data = root->data;
-	    root->data = temp;
-	}
-    }
+    int counts[256] = {0};
+    for (node *n = vine; n != NULL; n = n->right)
+	counts[(unsigned char)n->data]++;
 
-    //if the tree has only one node on the right
-    if (root->left == NULL && root->right != NULL)
+    node *n = vine;
+    for (int key = 0; key < 256; key++)
     {
-	//if the right node is less than the root node
-	if (root->right->data < root->data)
+	for (int i = 0; i < counts[key]; i++)
 	{
-	    //swap the data
-	    char temp = root->right->data;
-	    root->right->data = root->data;
-	    root->data = temp;
+	    n->data = (char)key;
+	    n = n->right;
 	}
     }
-    //recursively call the function on the left and right subtrees
-    convertToAVL(root->left);
-    convertToAVL(root->right);
-    return root;
+}
+
+//function to convert the unordered tree to an AVL tree, reusing its nodes
+node *convertToAVL(node *root)
+{
+    node pseudoRoot;
+    pseudoRoot.left = NULL;
+    pseudoRoot.right = root;
+
+    int size = treeToVine(&pseudoRoot);
+    countingSortVine(pseudoRoot.right);
+    vineToTree(&pseudoRoot, size);
+
+    return pseudoRoot.right;
 }
 
 int main(){
-	//note this code doesn't balance the tree automatically, just for the sake of clarity and demonstration
-	//it simply converts the tree to an AVL tree
-	//however, if one wishes to make a self-balancing AVL tree, all that is needed to do is to add a function
-	//that checks the height of the left and right subtrees and balances the tree accordingly
-	//which is trivial to do, and if you need me to do it, shoot me an email :) or look at my final project
+	//note the converted tree is balanced once, when it is converted
+	//it is not a self-balancing AVL tree, inserting into it afterwards would need the usual AVL rotations
 
 	//create the unbalanced tree
 	node *root = newNode('A');
@@ -0,0 +1,313 @@
+//traversal engines for binary trees of nodes with data, left and right members
+//they call a visitor for each node instead of printing, and never recurse
+
+#ifndef TRAVERSAL_H
+#define TRAVERSAL_H
+
+#include <cstdio>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+    Morris traversals use O(1) extra space: before going down into a left subtree they point
+    the right link of its last in-order node (the predecessor) back up at the current node,
+    and follow that thread to get back up instead of popping a stack. Every thread is removed
+    on the second visit, so the tree is unchanged when they return.
+    Each edge is walked at most a constant number of times, so they are still O(n).
+    The visitor must not modify the links of the tree while the traversal runs.
+*/
+
+//in order, left - root - right
+template <class Node, class Visit>
+void morrisInorder(Node *root, Visit &&visit)
+{
+    Node *current = root;
+    while (current != NULL)
+    {
+	if (current->left == NULL)
+	{
+	    visit(current);
+	    current = current->right;
+	    continue;
+	}
+
+	//find the predecessor, stopping at the thread if we already made one
+	Node *pred = current->left;
+	while (pred->right != NULL && pred->right != current)
+	    pred = pred->right;
+
+	if (pred->right == NULL)
+	{
+	    pred->right = current;
+	    current = current->left;
+	}
+	else
+	{
+	    pred->right = NULL;
+	    visit(current);
+	    current = current->right;
+	}
+    }
+}
+
+//pre order, root - left - right, same threads but the node is visited on the way down
+template <class Node, class Visit>
+void morrisPreorder(Node *root, Visit &&visit)
+{
+    Node *current = root;
+    while (current != NULL)
+    {
+	if (current->left == NULL)
+	{
+	    visit(current);
+	    current = current->right;
+	    continue;
+	}
+
+	Node *pred = current->left;
+	while (pred->right != NULL && pred->right != current)
+	    pred = pred->right;
+
+	if (pred->right == NULL)
+	{
+	    visit(current);
+	    pred->right = current;
+	    current = current->left;
+	}
+	else
+	{
+	    pred->right = NULL;
+	    current = current->right;
+	}
+    }
+}
+
+//reverse the right links from 'from' down to 'to', so the chain can be walked bottom up
+template <class Node>
+void reverseRightChain(Node *from, Node *to)
+{
+    if (from == to)
+	return;
+    Node *x = from;
+    Node *y = from->right;
+    while (x != to)
+    {
+	Node *z = y->right;
+	y->right = x;
+	x = y;
+	y = z;
+    }
+}
+
+/*
+    post order, left - right - root
+    a dummy node takes the whole tree as its left subtree, and when a thread is found
+    the right chain from current->left down to the predecessor is visited bottom up,
+    by reversing it in place, visiting, and reversing it back
+*/
+template <class Node, class Visit>
+void morrisPostorder(Node *root, Visit &&visit)
+{
+    Node dummy = Node();
+    dummy.left = root;
+    dummy.right = NULL;
+
+    Node *current = &dummy;
+    while (current != NULL)
+    {
+	if (current->left == NULL)
+	{
+	    current = current->right;
+	    continue;
+	}
+
+	Node *pred = current->left;
+	while (pred->right != NULL && pred->right != current)
+	    pred = pred->right;
+
+	if (pred->right == NULL)
+	{
+	    pred->right = current;
+	    current = current->left;
+	}
+	else
+	{
+	    reverseRightChain(current->left, pred);
+	    for (Node *n = pred; ; n = n->right)
+	    {
+		visit(n);
+		if (n == current->left)
+		    break;
+	    }
+	    reverseRightChain(pred, current->left);
+	    pred->right = NULL;
+	    current = current->right;
+	}
+    }
+}
+
+/*
+    explicit stack traversals, for trees that may be shared or read concurrently and so must
+    not be threaded; they take the stack from the caller, so a stack reused across calls stops
+    allocating once it has grown to the height of the tallest tree
+*/
+template <class Node, class Visit>
+void stackPreorder(Node *root, Visit &&visit, std::vector<Node *> &stack)
+{
+    stack.clear();
+    if (root != NULL)
+	stack.push_back(root);
+    while (!stack.empty())
+    {
+	Node *n = stack.back();
+	stack.pop_back();
+	visit(n);
+	if (n->right != NULL)
+	    stack.push_back(n->right);
+	if (n->left != NULL)
+	    stack.push_back(n->left);
+    }
+}
+
+template <class Node, class Visit>
+void stackInorder(Node *root, Visit &&visit, std::vector<Node *> &stack)
+{
+    stack.clear();
+    Node *current = root;
+    while (current != NULL || !stack.empty())
+    {
+	while (current != NULL)
+	{
+	    stack.push_back(current);
+	    current = current->left;
+	}
+	current = stack.back();
+	stack.pop_back();
+	visit(current);
+	current = current->right;
+    }
+}
+
+//post order with one stack, a node is visited once its right subtree is done
+template <class Node, class Visit>
+void stackPostorder(Node *root, Visit &&visit, std::vector<Node *> &stack)
+{
+    stack.clear();
+    Node *current = root;
+    Node *last = NULL;
+    while (current != NULL || !stack.empty())
+    {
+	while (current != NULL)
+	{
+	    stack.push_back(current);
+	    current = current->left;
+	}
+	Node *top = stack.back();
+	if (top->right != NULL && top->right != last)
+	{
+	    current = top->right;
+	}
+	else
+	{
+	    visit(top);
+	    last = top;
+	    stack.pop_back();
+	}
+    }
+}
+
+/*
+    output sink that collects text in a fixed buffer and hands it to stdio in large blocks,
+    instead of one iostream call per key
+    used as a visitor it prints the node's data followed by a space, like the recursive printers;
+    the data can be a char, written as is, a bool, written as 0 or 1, any other integer or
+    floating point number, written in decimal, or a std::string; other data does not compile
+    flush it (or let it go out of scope) before writing to cout again, so the output stays in order
+*/
+class BufferedSink
+{
+public:
+    explicit BufferedSink(FILE *out = stdout) : out(out), used(0) {}
+    ~BufferedSink() { flush(); }
+
+    void put(char c)
+    {
+	if (used == sizeof(buffer))
+	    flush();
+	buffer[used++] = c;
+    }
+
+    void write(const char *s, size_t n)
+    {
+	for (size_t i = 0; i < n; i++)
+	    put(s[i]);
+    }
+
+    void flush()
+    {
+	if (used > 0)
+	    fwrite(buffer, 1, used, out);
+	used = 0;
+	fflush(out);
+    }
+
+    template <class Node>
+    void operator()(const Node *n)
+    {
+	value(n->data);
+	put(' ');
+    }
+
+private:
+    void value(char c) { put(c); }
+
+    void value(bool b) { put(b ? '1' : '0'); }
+
+    void value(const std::string &s) { write(s.data(), s.size()); }
+
+    template <class T>
+    void value(const T &x)
+    {
+	static_assert(std::is_arithmetic<T>::value, "BufferedSink prints char, number and std::string data");
+	number(x, std::is_integral<T>());
+    }
+
+    //digits written backwards into a small buffer, the magnitude taken unsigned so the
+    //most negative value has one
+    template <class T>
+    void number(T x, std::true_type)
+    {
+	typedef typename std::make_unsigned<T>::type U;
+	U magnitude = (U)x;
+	if (x < T(0))
+	{
+	    put('-');
+	    magnitude = U(0) - magnitude;
+	}
+	char digits[24];
+	size_t n = 0;
+	do
+	{
+	    digits[n++] = (char)('0' + magnitude % 10);
+	    magnitude /= 10;
+	} while (magnitude != 0);
+	while (n > 0)
+	    put(digits[--n]);
+    }
+
+    template <class T>
+    void number(T x, std::false_type)
+    {
+	char text[32];
+	int n = snprintf(text, sizeof(text), "%g", (double)x);
+	write(text, (size_t)n);
+    }
+
+    FILE *out;
+    size_t used;
+    char buffer[1 << 16];
+};
+
+#endif
@@ -20,63 +20,278 @@
 */
 
 #include <iostream>
+#include <string>
 #include <vector>
-#include <sstream> //because strings are immutable
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 using namespace std; //acceptable sin for small programs
 
-//convencience to print the matrix
-void printMatrix(vector<vector<char>>& matrix){
-    for(int i = 0; i < matrix.size(); i++){
-        for(int j = 0; j < matrix[i].size(); j++){
-            cout << matrix[i][j];
-        }
-        cout << endl;
+/*
+    render the plus pattern of the n characters at s, handing the text to write(data, size)
+    in pieces, without building the n x n matrix
+    every row but the middle one is all X's except for one character, so a block of rows is
+    filled with X's once, and for each block only the middle column is overwritten before
+    the block is written as one piece, memory is one block, O(n)
+    block is scratch space, passing the same one for many strings saves allocating it each time
+*/
+template <class Write>
+void renderPlusTo(const char* s, size_t n, vector<char>& block, Write&& write){
+    //an even length string gets an X on the end, so there is a middle
+    const bool padded = n % 2 == 0;
+    const size_t len = padded ? n + 1 : n;
+    const size_t mid = len / 2;
+    const size_t width = len + 1; //row plus the newline
+
+    //as many rows as fit in 64 KiB, but always at least one and never more than the pattern has
+    const size_t rows = max<size_t>(1, min<size_t>(len, (1 << 16) / width));
+    block.assign(rows * width, 'X');
+    for(size_t r = 0; r < rows; r++){
+        block[r * width + len] = '\n';
     }
+
+    //write rows [first, last) of the vertical bar
+    auto writeRows = [&](size_t first, size_t last){
+        while(first < last){
+            const size_t count = min(rows, last - first);
+            for(size_t r = 0; r < count; r++){
+                block[r * width + mid] = first + r < n ? s[first + r] : 'X';
+            }
+            write(block.data(), count * width);
+            first += count;
+        }
+    };
+
+    writeRows(0, mid);
+    write(s, n); //the middle row is the string itself
+    write(padded ? "X\n" : "\n", padded ? 2 : 1);
+    writeRows(mid + 1, len);
 }
 
-//main function
-int main(){
-    //input for string to process,
-    string input;
-    //initializing the length of the string, and the middle
-    int len, mid;
-    //as well as the stringstream incase the string is even
-    stringstream buff;
+//stream the plus pattern of input to out
+void renderPlus(const string& input, FILE* out){
+    vector<char> block;
+    renderPlusTo(input.data(), input.length(), block, [out](const char* data, size_t size){
+        fwrite(data, 1, size, out);
+    });
+}
 
-    //prompt for input
-    cout << "Enter a string: ";
-    cin >> input;
+//a line of the batch input, as an offset and length into the text of its chunk
+struct Line {
+    size_t begin, length;
+};
+
+/*
+    a run of consecutive lines, with their text, rendered by one worker into its own buffer
+    a line whose pattern alone is bigger than kStreamBytes gets a chunk of its own that is not
+    rendered ahead, the writer streams it straight to the output when its turn comes
+*/
+struct Chunk {
+    string text;
+    vector<Line> lines;
+    bool stream;
+    bool ready;
+    string out;
+};
+
+const size_t kChunkBytes = 1 << 20;
+const size_t kStreamBytes = 64 << 20;
+
+//size of the pattern of an n character string
+size_t patternBytes(size_t n){
+    const size_t len = n % 2 == 0 ? n + 1 : n;
+    return len * (len + 1);
+}
 
-    //prepare the stringstream buffer with the input just in case
-    buff << input;
+//the lines of a file, read in large blocks; empty lines are skipped, a trailing \r is dropped
+class LineReader {
+public:
+    explicit LineReader(FILE* in) : in(in), buffer(1 << 20), pos(0), len(0) {}
 
-    //get the length of the string and the middle
-    len = input.length();
+    //the next line into line, false at the end of the input
+    bool next(string& line){
+        line.clear();
+        while(true){
+            if(pos == len){
+                len = fread(buffer.data(), 1, buffer.size(), in);
+                pos = 0;
+                if(len == 0)
+                    return finish(line);
+            }
+            const char* start = buffer.data() + pos;
+            const char* newline = (const char*)memchr(start, '\n', len - pos);
+            const size_t count = newline ? newline - start : len - pos;
+            line.append(start, count);
+            pos += count;
+            if(newline){
+                pos++;
+                if(finish(line))
+                    return true;
+            }
+        }
+    }
 
-    //if the string is of even length
-    if(len % 2 == 0){
-        buff.put('X'); //add an X to the end of the input string so we have an uneven number
-        len++; //increment the length
+private:
+    //drop the \r, and whether what is left is a line to return
+    static bool finish(string& line){
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+        return !line.empty();
     }
 
-    input = buff.str(); //update the input string
-    buff.str(string());    
-    buff.clear(); //clear the buffer
+    FILE* in;
+    vector<char> buffer;
+    size_t pos, len;
+};
 
-    mid = len/2; //get the middle
+/*
+    render the pattern of every line of in to out, in the order of the lines
+    the input is streamed: this thread reads lines into chunks of about kChunkBytes of output
+    and hands them to a pool of threads that render each chunk into its own buffer, while it
+    writes the finished chunks in order; at most a window of chunks is read ahead of the writer,
+    so memory is bounded by the window and the longest line, not by the size of the input
+*/
+void renderBatch(FILE* in, FILE* out, unsigned threads){
+    const size_t window = 2 * threads;
+    deque<Chunk> chunks; //read and not yet written, in order; push_back and pop_front keep references valid
+    deque<Chunk*> pending; //chunks no worker has taken yet
+    bool done = false;
+    mutex lock;
+    condition_variable changed;
 
-    //initalize the matrix of size n x n and fill it with X's
-    vector<vector<char>> matrix(len, vector<char>(len, 'X'));
+    auto worker = [&](){
+        vector<char> block;
+        while(true){
+            Chunk* chunk;
+            {
+                unique_lock<mutex> guard(lock);
+                changed.wait(guard, [&]{ return done || !pending.empty(); });
+                if(pending.empty())
+                    return;
+                chunk = pending.front();
+                pending.pop_front();
+            }
+            for(const Line& line : chunk->lines){
+                renderPlusTo(chunk->text.data() + line.begin, line.length, block, [chunk](const char* data, size_t size){
+                    chunk->out.append(data, size);
+                });
+            }
+            {
+                lock_guard<mutex> guard(lock);
+                chunk->ready = true;
+            }
+            changed.notify_all();
+        }
+    };
 
-    //fill the matrix with the input strbg in the middle
-    for(int i = 0; i < len; i++){
-        matrix[i][mid] = input[i];
-        matrix[mid][i] = input[i];
+    vector<thread> pool;
+    for(unsigned t = 0; t < threads; t++){
+        pool.emplace_back(worker);
     }
 
-    //print the matrix
-    printMatrix(matrix);
+    LineReader reader(in);
+    string line;
+    bool more = reader.next(line);
+    vector<char> block;
+    while(true){
+        //read ahead until the window is full, the chunks only change hands under the lock
+        size_t inFlight;
+        {
+            lock_guard<mutex> guard(lock);
+            inFlight = chunks.size();
+        }
+        while(more && inFlight < window){
+            Chunk chunk;
+            chunk.stream = patternBytes(line.size()) > kStreamBytes;
+            chunk.ready = chunk.stream;
+            size_t bytes = 0;
+            do {
+                const Line l = { chunk.text.size(), line.size() };
+                chunk.text += line;
+                chunk.lines.push_back(l);
+                bytes += patternBytes(line.size());
+                more = reader.next(line);
+            } while(!chunk.stream && more && bytes < kChunkBytes && patternBytes(line.size()) <= kStreamBytes);
+            {
+                lock_guard<mutex> guard(lock);
+                chunks.push_back(move(chunk));
+                if(!chunks.back().stream)
+                    pending.push_back(&chunks.back());
+            }
+            changed.notify_all();
+            inFlight++;
+        }
+
+        Chunk* front;
+        {
+            unique_lock<mutex> guard(lock);
+            if(chunks.empty())
+                break;
+            front = &chunks.front();
+            changed.wait(guard, [&]{ return front->ready; });
+        }
+        if(front->stream){
+            renderPlusTo(front->text.data(), front->text.size(), block, [out](const char* data, size_t size){
+                fwrite(data, 1, size, out);
+            });
+        } else {
+            fwrite(front->out.data(), 1, front->out.size(), out);
+        }
+        {
+            lock_guard<mutex> guard(lock);
+            chunks.pop_front();
+        }
+    }
+
+    {
+        lock_guard<mutex> guard(lock);
+        done = true;
+    }
+    changed.notify_all();
+    for(size_t t = 0; t < pool.size(); t++){
+        pool[t].join();
+    }
+    fflush(out);
+}
+
+//at most this many batch threads per core
+const unsigned kThreadsPerCore = 4;
+
+//main function
+//run with "batch [threads]" to print the pattern of every line of stdin, without prompting
+//threads defaults to one per core, and is clamped to between 1 and kThreadsPerCore per core
+int main(int argc, char* argv[]){
+    if(argc > 1 && strcmp(argv[1], "batch") == 0){
+        const long cores = max(1u, thread::hardware_concurrency());
+        long threads = cores;
+        if(argc > 2){
+            char* end;
+            threads = strtol(argv[2], &end, 10);
+            if(end == argv[2] || *end != '\0'){
+                fprintf(stderr, "usage: printPlus batch [threads]\n");
+                return EXIT_FAILURE;
+            }
+        }
+        renderBatch(stdin, stdout, (unsigned)min(max(threads, 1L), cores * kThreadsPerCore));
+        return EXIT_SUCCESS;
+    }
+
+    //input for string to process,
+    string input;
+
+    //prompt for input
+    cout << "Enter a string: ";
+    cin >> input;
+    cout.flush();
+
+    //print the pattern
+    renderPlus(input, stdout);
 
     return EXIT_SUCCESS;
 }